@@ -6,48 +6,87 @@ apt-get -qq install build-essential
 apt-get -qq install libusb-1.0-0-dev
 echo Copying source code files...
 mkdir -p /usr/local/src/itusb2/man
+cp -f src/awaitable.h /usr/local/src/itusb2/.
+cp -f src/commands.cpp /usr/local/src/itusb2/.
+cp -f src/commands.h /usr/local/src/itusb2/.
 cp -f src/cp2130.cpp /usr/local/src/itusb2/.
 cp -f src/cp2130.h /usr/local/src/itusb2/.
 cp -f src/error.cpp /usr/local/src/itusb2/.
 cp -f src/error.h /usr/local/src/itusb2/.
+cp -f src/eventloop.cpp /usr/local/src/itusb2/.
+cp -f src/eventloop.h /usr/local/src/itusb2/.
 cp -f src/GPL.txt /usr/local/src/itusb2/.
 cp -f src/itusb2-attach.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2-cycle.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2d.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-detach.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2device.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2device.h /usr/local/src/itusb2/.
 cp -f src/itusb2-enum.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2-group.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-info.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2-limit.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-list.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-lockotp.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2-monitor.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-reset.cpp /usr/local/src/itusb2/.
+cp -f src/itusb2-sequence.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-status.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-udoff.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-udon.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-upoff.cpp /usr/local/src/itusb2/.
 cp -f src/itusb2-upon.cpp /usr/local/src/itusb2/.
 cp -f src/LGPL.txt /usr/local/src/itusb2/.
+cp -f src/libitusb2.cpp /usr/local/src/itusb2/.
+cp -f src/libitusb2.h /usr/local/src/itusb2/.
+cp -f src/libitusb2.pc.in /usr/local/src/itusb2/.
 cp -f src/libusb-extra.c /usr/local/src/itusb2/.
 cp -f src/libusb-extra.h /usr/local/src/itusb2/.
 cp -f src/Makefile /usr/local/src/itusb2/.
+cp -f src/man/itusb2.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-attach.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2-cycle.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2d.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-detach.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-enum.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2-group.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-info.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2-limit.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-list.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-lockotp.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2-monitor.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-reset.1 /usr/local/src/itusb2/man/.
+cp -f src/man/itusb2-sequence.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-status.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-udoff.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-udon.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-upoff.1 /usr/local/src/itusb2/man/.
 cp -f src/man/itusb2-upon.1 /usr/local/src/itusb2/man/.
+cp -f src/metrics.cpp /usr/local/src/itusb2/.
+cp -f src/metrics.h /usr/local/src/itusb2/.
+cp -f src/monitor.cpp /usr/local/src/itusb2/.
+cp -f src/monitor.h /usr/local/src/itusb2/.
+cp -f src/output.cpp /usr/local/src/itusb2/.
+cp -f src/output.h /usr/local/src/itusb2/.
+cp -f src/protocol.cpp /usr/local/src/itusb2/.
+cp -f src/protocol.h /usr/local/src/itusb2/.
 cp -f src/README.txt /usr/local/src/itusb2/.
+cp -f src/realtime.cpp /usr/local/src/itusb2/.
+cp -f src/realtime.h /usr/local/src/itusb2/.
+cp -f src/sequencer.cpp /usr/local/src/itusb2/.
+cp -f src/sequencer.h /usr/local/src/itusb2/.
+cp -f src/statistics.cpp /usr/local/src/itusb2/.
+cp -f src/statistics.h /usr/local/src/itusb2/.
+cp -f src/worker.cpp /usr/local/src/itusb2/.
+cp -f src/worker.h /usr/local/src/itusb2/.
 echo Building and installing binaries and man pages...
 make -C /usr/local/src/itusb2 install clean
+ldconfig
 echo Applying configurations...
 cat > /etc/udev/rules.d/70-bgtn-itusb2.rules << EOF
-SUBSYSTEM=="usb", ATTRS{idVendor}=="10c4", ATTRS{idProduct}=="8cdf", MODE="0666"
-SUBSYSTEM=="usb_device", ATTRS{idVendor}=="10c4", ATTRS{idProduct}=="8cdf", MODE="0666"
+SUBSYSTEM=="usb", ATTRS{idVendor}=="10c4", ATTRS{idProduct}=="8cdf", GROUP="plugdev", MODE="0660"
+SUBSYSTEM=="usb_device", ATTRS{idVendor}=="10c4", ATTRS{idProduct}=="8cdf", GROUP="plugdev", MODE="0660"
 EOF
 service udev restart
 echo Done!
@@ -0,0 +1,139 @@
+/* ITUSB2 Asynchronous API Check - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// This program is built by "make check", as C++20, so that the awaitable API is compiled and exercised
+// It reattaches every connected device, and then reads its status, driving all devices from a single event loop thread through coroutines
+// The devices are operated concurrently, so the whole run takes about as long as a single reattachment, whatever the number of devices
+
+// Includes
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "awaitable.h"
+#include "eventloop.h"
+#include "itusb2device.h"
+
+#if __cplusplus < 202002L
+#error "This program requires C++20 or later."
+#endif
+
+// Outcome of the check of a single device
+struct Check {
+    std::string serial;
+    ITUSB2Device device;
+    ITUSB2Device::Status status;
+    int errcnt;
+    std::string errstr;
+};
+
+// Completion shared by all checks, so that the main thread can wait for every coroutine to finish
+struct Completion {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending;
+};
+
+// Function prototypes
+AsyncTask checkDevice(EventLoop &loop, Check &check, Completion &completion);
+
+int main()
+{
+    int errcnt = 0, errlvl = EXIT_SUCCESS;
+    std::string errstr;
+    std::list<std::string> serials = ITUSB2Device::listDevices(errcnt, errstr);
+    std::vector<std::unique_ptr<Check>> checks;
+    for (const std::string &serial : serials) {
+        std::unique_ptr<Check> check(new Check());  // Value initialized, so that the status and the error count start at zero
+        check->serial = serial;
+        if (check->device.open(serial) != ITUSB2Device::SUCCESS) {
+            ++check->errcnt;
+            check->errstr += "Could not open device.\n";
+        } else {
+            check->device.setup(check->errcnt, check->errstr);  // Prepare the device (SPI setup)
+        }
+        checks.push_back(std::move(check));
+    }
+    EventLoop loop;
+    Completion completion;
+    completion.pending = checks.size();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    loop.start();
+    for (std::unique_ptr<Check> &check : checks) {
+        loop.post([&loop, &check, &completion]() {
+            checkDevice(loop, *check, completion);  // The coroutine runs until its first suspension, and is then resumed by the loop thread
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(completion.mutex);
+        completion.done.wait(lock, [&completion]() {
+            return completion.pending == 0;
+        });
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    loop.stop();
+    for (std::unique_ptr<Check> &check : checks) {
+        check->device.close();
+        std::cout << check->serial << ": ";
+        if (check->errcnt > 0) {
+            std::cout << "Error: " << check->errstr;
+            errlvl = EXIT_FAILURE;
+        } else {
+            std::cout << "Power " << (check->status.up ? "on" : "off") << ", data " << (check->status.ud ? "on" : "off") << ", current " << std::fixed << std::setprecision(1) << check->status.current << "mA\n";
+        }
+    }
+    std::cout << checks.size() << " devices checked in " << std::fixed << std::setprecision(1) << elapsed << "ms, from a single event loop thread.\n";
+    if (errcnt > 0) {
+        std::cerr << "Error: " << errstr;
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
+
+// Detaches and reattaches the given device, and then reads its status, without ever blocking the loop thread
+AsyncTask checkDevice(EventLoop &loop, Check &check, Completion &completion)
+{
+    if (check.errcnt == 0) {
+        AsyncResult<void> detached = co_await check.device.detachAsync(loop);
+        check.errcnt += detached.errcnt;
+        check.errstr += detached.errstr;
+    }
+    if (check.errcnt == 0) {
+        AsyncResult<void> attached = co_await check.device.attachAsync(loop);  // The waits between steps are timers of the event loop
+        check.errcnt += attached.errcnt;
+        check.errstr += attached.errstr;
+    }
+    if (check.errcnt == 0) {
+        AsyncResult<ITUSB2Device::Status> status = co_await check.device.getStatusAsync(loop);
+        check.status = status.value;
+        check.errcnt += status.errcnt;
+        check.errstr += status.errstr;
+    }
+    std::lock_guard<std::mutex> lock(completion.mutex);
+    if (--completion.pending == 0) {
+        completion.done.notify_one();
+    }
+}
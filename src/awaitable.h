@@ -0,0 +1,132 @@
+/* ITUSB2 awaitable operations - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef AWAITABLE_H
+#define AWAITABLE_H
+
+// The asynchronous operations of CP2130 and ITUSB2Device report their results through callbacks, which only require C++11
+// When compiling as C++20 or later, the templates below also allow those operations to be awaited from coroutines, via "co_await"
+// The awaitable overloads are defined inline in the headers, so that they are available to C++20 code even if the library itself is built as C++11
+
+#if __cplusplus >= 202002L
+
+// Includes
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+
+// Result of an awaited operation, which holds the same values that would be passed to the corresponding callback
+template <typename T>
+struct AsyncResult {
+    T value;             // Value obtained by the operation
+    int errcnt;          // Number of errors that occurred
+    std::string errstr;  // Errors that occurred, if any
+};
+
+// Result of an awaited operation that does not obtain a value
+template <>
+struct AsyncResult<void> {
+    int errcnt;          // Number of errors that occurred
+    std::string errstr;  // Errors that occurred, if any
+};
+
+// Awaitable that starts a callback-based operation when the coroutine is suspended, and resumes the coroutine when the operation calls back
+// Note that the coroutine is resumed from the thread that calls back, which is the event loop thread for any operation that involves a transfer
+// If the operation calls back before it is started (e.g., because a transfer could not be submitted), the coroutine is not suspended at all
+template <typename T>
+class Awaitable
+{
+public:
+    typedef std::function<void(AsyncResult<T>)> Resumer;
+    typedef std::function<void(const Resumer &)> Starter;
+
+private:
+    Starter starter_;
+    AsyncResult<T> result_;
+    std::atomic<bool> completed_;  // Set by whichever comes first, the callback or the end of await_suspend(), so that the other knows it came last
+
+public:
+    explicit Awaitable(Starter starter) :
+        starter_(std::move(starter)),
+        result_(),
+        completed_(false)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    // Returns false if the operation already called back, so that the coroutine simply continues
+    // Resuming the coroutine from here instead would be wrong, since it could then run to completion and be destroyed before this function returns
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        starter_([this, handle](AsyncResult<T> result) {
+            result_ = std::move(result);
+            if (completed_.exchange(true)) {  // The coroutine is already suspended
+                handle.resume();
+            }
+        });
+        return !completed_.exchange(true);
+    }
+
+    AsyncResult<T> await_resume()
+    {
+        return std::move(result_);
+    }
+};
+
+// Return type for coroutines that are started and then left to run on their own, driven by the event loop
+// The coroutine frame is destroyed once the coroutine returns
+struct AsyncTask {
+    struct promise_type {
+        AsyncTask get_return_object() noexcept
+        {
+            return AsyncTask();
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+#endif  // __cplusplus >= 202002L
+
+#endif  // AWAITABLE_H
@@ -0,0 +1,390 @@
+/* ITUSB2 command functions - Version 1.1.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <codecvt>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include "commands.h"
+#include "protocol.h"
+#include "realtime.h"
+#include "worker.h"
+
+// Global variables
+static RealtimeStatus realtime = {false, false, false, false, false, {0, -1}, std::string()};  // Real-time settings in effect, applied by applyRealtime()
+
+// Applies the real-time settings requested through the ITUSB2_REALTIME environment variable, once per process (added in version 1.3.0)
+static void applyRealtime()
+{
+    static bool applied = false;
+    if (!applied) {
+        realtime = enableRealtimeFromEnv();
+        applied = true;
+    }
+}
+
+// Applies the retry policy requested through the ITUSB2_RETRY environment variable to the given device, which must be open (added in version 1.3.0)
+// An invalid setting is reported and ignored, so that the command runs anyway
+static void applyRetry(ITUSB2Device &device)
+{
+    const char *env = std::getenv("ITUSB2_RETRY");
+    if (env != nullptr && *env != '\0') {
+        ITUSB2Device::RetryPolicy policy;
+        if (ITUSB2Device::parseRetryPolicy(env, policy)) {
+            int errcnt = 0;
+            std::string errstr;
+            device.setRetryPolicy(policy, errcnt, errstr);  // A failure to read the serial number only affects automatic reconnection, which would then reopen the first device found
+        } else {
+            std::cerr << "Invalid ITUSB2_RETRY setting \"" << env << "\", ignored.\n";
+        }
+    }
+}
+
+// Switches the lines of the device through the given worker, if any, or directly otherwise (added in version 1.3.0)
+// Through a worker, the operation is serialized and may be coalesced with the same operation requested concurrently by other clients of the daemon
+static void performSwitch(ITUSB2Device &device, DeviceWorker *worker, int operation, bool value, int &errcnt, std::string &errstr)
+{
+    DeviceWorker::Result result = worker != nullptr ? worker->post(operation, value).get() : DeviceWorker::perform(device, operation, value);
+    if (!result.success) {
+        ++errcnt;
+        errstr += result.error;
+    }
+}
+
+// Prints the enumeration test results
+static void printTiming(const ITUSB2Device::EnumTiming &timing, Output &output, std::ostream &out)
+{
+    if (output.format() != Output::TEXT) {
+        output.record(Record().boolean("connected", timing.cd).boolean("high_speed", timing.hs).integer("connect_us", timing.cdLatency).integer("connect_resolution_us", timing.cdResolution).integer("high_speed_us", timing.hsLatency).integer("high_speed_resolution_us", timing.hsResolution).integer("connect_edges", timing.cdEdges).boolean("counter_overflow", timing.cdOverflow));
+    } else {
+        out << "USB device ";
+        if (timing.cd) {
+            out << "enumerated in " << (timing.hs ? "high speed" : "full/low speed") << ".\n";
+            out << std::fixed << std::setprecision(3);
+            out << "Time to connect: " << timing.cdLatency / 1000.0 << "ms (resolution " << timing.cdResolution / 1000.0 << "ms)\n";  // Time from VBUS on to UDCD
+            if (timing.hs) {
+                out << "Time to high speed: " << timing.hsLatency / 1000.0 << "ms (resolution " << timing.hsResolution / 1000.0 << "ms)\n";  // Time from UDCD to UDHS
+            }
+            if (timing.cdOverflow) {
+                out << "Connection bounces: More than 65534\n";  // The event counter overflowed
+            } else if (timing.cdEdges > 1) {
+                out << "Connection bounces: " << timing.cdEdges - 1 << "\n";  // Every UDCD rising edge after the first one is a bounce
+            }
+        } else {
+            out << "not detected.\n";
+        }
+    }
+}
+
+// Prints the device information
+static void printInfo(ITUSB2Device &device, Output &output, std::ostream &out, int &errcnt, std::string &errstr)
+{
+    std::u16string manufacturer = device.getManufacturerDesc(errcnt, errstr);  // Manufacturer descriptor
+    std::u16string product = device.getProductDesc(errcnt, errstr);  // Product descriptor
+    std::u16string serial = device.getSerialDesc(errcnt, errstr);  // Serial number descriptor
+    CP2130::USBConfig config = device.getUSBConfig(errcnt, errstr);  // USB configuration
+    ITUSB2Device::Calibration calibration = {0, 1, {}};
+    bool calibrated = errcnt == 0 && ITUSB2Device::readCalibration(std::string(serial.begin(), serial.end()), calibration, errcnt, errstr);  // Calibration data, if any (serial numbers are plain ASCII)
+    if (errcnt == 0) {
+        std::wstring_convert<std::codecvt_utf8<char16_t>, char16_t> converter;
+        if (output.format() != Output::TEXT) {
+            output.record(Record().string("manufacturer", converter.to_bytes(manufacturer)).string("product", converter.to_bytes(product)).string("serial", converter.to_bytes(serial)).string("hardware_revision", ITUSB2Device::hardwareRevision(config)).integer("release", config.majrel << 8 | config.minrel).integer("max_power_ma", 2 * config.maxpow).boolean("calibrated", calibrated).number("calibration_offset_ma", calibration.offset, 3).number("calibration_gain", calibration.gain, 6).integer("calibration_points", static_cast<long long>(calibration.points.size())));
+        } else {
+            out << "Manufacturer: " << converter.to_bytes(manufacturer) << "\n";  // Print manufacturer string
+            out << "Product: " << converter.to_bytes(product) << "\n";  // Print product string
+            out << "Serial number: " << converter.to_bytes(serial) << "\n";  // Print serial number string
+            out << "Hardware revision: " << ITUSB2Device::hardwareRevision(config) << " [0x" << std::hex << std::setfill ('0') << std::setw(4) << (config.majrel << 8 | config.minrel) << std::dec << "]\n";  // Print hardware revision
+            out << "Maximum power consumption: " << 2 * config.maxpow << "mA [0x" << std::hex << std::setw(2) << static_cast<int>(config.maxpow) << std::dec << "]\n";  // Print maximum power consumption
+            out << "Current calibration: ";
+            if (calibrated) {
+                out << "offset " << calibration.offset << "mA, gain " << calibration.gain << ", " << calibration.points.size() << " table points\n";  // Print calibration data
+            } else {
+                out << "None\n";
+            }
+        }
+    }
+}
+
+// Prints the device status
+static void printStatus(ITUSB2Device &device, Output &output, std::ostream &out, int &errcnt, std::string &errstr)
+{
+    if (!device.isConfigured()) {  // This is always the case for a newly opened device, but not for one that is kept open (e.g., by the daemon)
+        device.setup(errcnt, errstr);  // Prepare the device (SPI setup)
+    }
+    ITUSB2Device::Status status = device.getStatus(errcnt, errstr);  // All status signals are obtained from a single transfer
+    if (errcnt == 0) {
+        if (output.format() != Output::TEXT) {
+            output.record(statusRecord(status));
+        } else {
+            out << "Status: Connection " << (status.up && status.ud ? "enabled" : "disabled") << "\n";  // Print USB connection status
+            out << "USB power: " << (status.up ? "Enabled" : "Disabled") << "\n";  // Print USB power status
+            out << "USB data: " << (status.ud ? "Enabled" : "Disabled") << "\n";  // Print USB data status
+            out << "Device: " << (status.cd ? "Detected" : "Not detected") << "\n";  // Print device detection status (note that a device can be detected even if the USB data lines are disabled)
+            if (status.up && status.ud && status.cd) {  // If USB connection is fully enabled and a device is detected
+                out << "Link mode: "  << (status.hs ? "High speed" : "Full/low speed") << "\n";  // Print USB link mode
+            }
+            out << "Current: ";
+            if (status.current < 1000) {  // If the current reading is lesser than 1000mA
+                out << std::fixed << std::setprecision(1) << status.current << "mA";  // Print the current reading
+                if (status.current > 500) {
+                    out << " (OC)";  // Print "(OC)" next to the value, to indicate that the current exceeds the 500mA limit established by the USB 2.0 specification (and also may cause a trip)
+                }
+            } else {  // Otherwise
+                out << "OL";  // Print "OL" to indicate an out of limits reading
+            }
+            out << "\n";
+            if (status.oc) {
+                out << "Warning: Fault detected!\n";  // Over-current or over-temperature trip condition detected
+            }
+        }
+    }
+}
+
+// Prints the confirmation message of a command that switches lines, or, in machine-readable formats, the resulting state of those lines
+static void printSwitch(const std::string &message, const Record &record, Output &output, std::ostream &out)
+{
+    if (output.format() != Output::TEXT) {
+        output.record(record);
+    } else {
+        out << message << "\n";
+    }
+}
+
+// Returns the output format given as the last parameter of a command, if any (commands accept "text", "csv" or "json" as an optional last parameter)
+// "nparams" is set to the number of the remaining parameters
+int commandFormat(const std::vector<std::string> &args, size_t &nparams)
+{
+    int format = Output::TEXT;
+    nparams = args.size() > 0 ? args.size() - 1 : 0;
+    if (nparams > 0 && Output::parseFormat(args.back(), format)) {
+        --nparams;
+    }
+    return format;
+}
+
+// This function is a shorthand version of the previous one
+int commandFormat(const std::vector<std::string> &args)
+{
+    size_t nparams;
+    return commandFormat(args, nparams);
+}
+
+// Parses the command line of a tool that executes a single command, which accepts an optional "--format" option and an optional serial number, and then executes the command - Returns the exit status
+// This is meant to be called from main(), and the command is forwarded to the daemon, if running
+int commandMain(const std::string &command, int argc, char **argv)
+{
+    std::string format = "text";
+    int fmt = Output::TEXT;
+    bool valid = true;
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            format = optarg;
+            valid = Output::parseFormat(format, fmt);
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || argc - optind > 1) {
+        printUsageError(fmt, "Usage: itusb2-" + command + " [--format=text|csv|json] [SERIALNUMBER]\n");
+        return EXIT_USERERR;
+    }
+    std::string serial = optind < argc ? argv[optind] : std::string();  // Specifying a serial number is optional
+    return runCommand(serial, {command, format});
+}
+
+// Executes a command on an open device, printing the results to "out" and any errors to "err"
+// The first argument is the command name, and any remaining ones are its parameters, optionally followed by the output format - Returns the exit status
+// Since version 1.3.0, the switching commands are carried out through the given worker, if any (see isSwitchCommand())
+int executeCommand(ITUSB2Device &device, const std::vector<std::string> &args, std::ostream &out, std::ostream &err, DeviceWorker *worker)
+{
+    int errcnt = 0, errlvl = EXIT_SUCCESS;
+    std::string errstr;
+    std::string command = args.empty() ? std::string() : args[0];
+    size_t nparams;
+    Output output(commandFormat(args, nparams), out, err);
+    if (command == "attach" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::ATTACH, true, errcnt, errstr);  // Attach DUT to HUT
+        if (errcnt == 0) {
+            printSwitch("USB device attached.", Record().boolean("power", true).boolean("data", true), output, out);
+        }
+    } else if (command == "detach" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::DETACH, false, errcnt, errstr);  // Detach DUT from HUT
+        if (errcnt == 0) {
+            printSwitch("USB device detached.", Record().boolean("power", false).boolean("data", false), output, out);
+        }
+    } else if (command == "enum" && nparams == 0) {
+        ITUSB2Device::EnumTiming timing = device.enumerate(errcnt, errstr);  // Detach and reattach DUT, measuring how long it takes to connect and to link at high speed
+        if (errcnt == 0) {
+            printTiming(timing, output, out);
+        }
+    } else if (command == "info" && nparams == 0) {
+        printInfo(device, output, out, errcnt, errstr);
+    } else if (command == "reset" && nparams == 0) {
+        device.reset(errcnt, errstr);  // Reset the target device
+        if (errcnt == 0) {
+            printSwitch("Reset issued.", Record().boolean("reset", true), output, out);
+        }
+    } else if (command == "status" && nparams == 0) {
+        printStatus(device, output, out, errcnt, errstr);
+    } else if (command == "udoff" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::SWITCH_DATA, false, errcnt, errstr);  // Disconnect the data lines
+        if (errcnt == 0) {
+            printSwitch("USB data disabled.", Record().boolean("data", false), output, out);
+        }
+    } else if (command == "udon" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::SWITCH_DATA, true, errcnt, errstr);  // Connect the data lines
+        if (errcnt == 0) {
+            printSwitch("USB data enabled.", Record().boolean("data", true), output, out);
+        }
+    } else if (command == "upoff" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::SWITCH_POWER, false, errcnt, errstr);  // Switch VBUS off
+        if (errcnt == 0) {
+            printSwitch("USB power disabled.", Record().boolean("power", false), output, out);
+        }
+    } else if (command == "upon" && nparams == 0) {
+        performSwitch(device, worker, DeviceWorker::SWITCH_POWER, true, errcnt, errstr);  // Switch VBUS on
+        if (errcnt == 0) {
+            printSwitch("USB power enabled.", Record().boolean("power", true), output, out);
+        }
+    } else {
+        output.error(ERRCODE_USAGE, "Unknown command or invalid parameters.\n");
+        errlvl = EXIT_USERERR;
+    }
+    if (errcnt > 0) {  // In case of error
+        reportDeviceErrors(device, errstr, output);
+        errlvl = EXIT_FAILURE;
+    }
+    out.flush();
+    return errlvl;
+}
+
+// Returns true if the given command only switches lines, and is therefore carried out through the worker given to executeCommand(), if any (added in version 1.3.0)
+bool isSwitchCommand(const std::vector<std::string> &args)
+{
+    size_t nparams;
+    commandFormat(args, nparams);
+    return nparams == 0 && (args[0] == "attach" || args[0] == "detach" || args[0] == "udoff" || args[0] == "udon" || args[0] == "upoff" || args[0] == "upon");
+}
+
+// Opens the device having the given serial number (or the first device found, if the serial number is empty), and returns the result of ITUSB2Device::open()
+// If the device is in use by the daemon, the daemon is asked to release it first, which is required by commands that need exclusive access to the device
+int openDevice(ITUSB2Device &device, const std::string &serial)
+{
+    applyRealtime();  // Since version 1.3.0, the real-time settings, if requested, are applied before the device is operated
+    int err = device.openDirect(serial);  // Since version 1.3.0, the device is opened without enumerating the USB devices on the host
+    if (err == ITUSB2Device::ERROR_BUSY && releaseDevice(serial)) {
+        err = device.openDirect(serial);
+    }
+    if (err == ITUSB2Device::SUCCESS) {
+        applyRetry(device);
+    }
+    return err;
+}
+
+// Reports the error corresponding to a failure to open the device
+void printOpenError(int err, Output &output)
+{
+    if (err == ITUSB2Device::ERROR_INIT) {  // Failed to initialize libusb
+        output.error(ERRCODE_INIT, "Could not initialize libusb\n");
+    } else if (err == ITUSB2Device::ERROR_NOT_FOUND) {  // Failed to find device
+        output.error(ERRCODE_NOT_FOUND, "Could not find device.\n");
+    } else if (err == ITUSB2Device::ERROR_BUSY) {  // Failed to claim interface
+        output.error(ERRCODE_BUSY, "Device is currently unavailable.\n");
+    }
+}
+
+// Reports invalid arguments in the given format, followed by the given usage text if the format is human readable (used by the main() function of each tool)
+// In machine-readable formats, a single error record is printed, so that usage errors can be told apart by their error code
+void printUsageError(int format, const std::string &usage)
+{
+    Output output(format, std::cout, std::cerr);
+    output.error(ERRCODE_USAGE, "Invalid arguments.\n");
+    if (format == Output::TEXT) {
+        std::cerr << usage;
+    }
+}
+
+// Reports the errors that occurred while operating the device, or that the device disconnected, if that is the case
+void reportDeviceErrors(const ITUSB2Device &device, const std::string &errstr, Output &output)
+{
+    if (device.disconnected()) {  // If the device disconnected
+        output.error(ERRCODE_DISCONNECTED, "Device disconnected.\n");
+    } else {
+        output.error(ERRCODE_DEVICE, errstr);
+    }
+}
+
+// Executes a command on the device having the given serial number (or on the first device found, if the serial number is empty), and returns the exit status
+// If the daemon is running, the command is forwarded to it, because it holds the device open - Otherwise, the device is opened directly
+int runCommand(const std::string &serial, const std::vector<std::string> &args)
+{
+    int errlvl;
+    if (!requestDaemon(serial, args, errlvl)) {  // If the daemon is not running
+        applyRealtime();
+        ITUSB2Device device;
+        int err = device.openDirect(serial);  // Open the device and get the device handle
+        if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+            applyRetry(device);
+            errlvl = executeCommand(device, args, std::cout, std::cerr);
+            reportRealtime(device);
+            reportRecovery(device);
+            device.close();
+        } else {  // Failed to open device
+            Output output(commandFormat(args), std::cout, std::cerr);
+            printOpenError(err, output);
+            errlvl = EXIT_FAILURE;
+        }
+    }
+    return errlvl;
+}
+
+// Reports the real-time settings in effect and the sleep jitter of the given device to the standard error, if real-time mode was requested (added in version 1.3.0)
+// The jitter is reported even if the settings could not be applied, so that both cases can be compared
+void reportRealtime(const ITUSB2Device &device)
+{
+    if (realtime.requested) {
+        ITUSB2Device::SleepJitter jitter = device.sleepJitter();
+        std::cerr << describeRealtime(realtime) << ".\n";
+        std::cerr << "Sleep jitter: " << jitter.sleeps << " wait" << (jitter.sleeps == 1 ? "" : "s") << ", mean " << std::fixed << std::setprecision(1) << jitter.mean << "us, max " << jitter.max << "us\n";
+    }
+}
+
+// Reports how many transfers were retried and how many times the given device was reconnected to the standard error, if any recovery took place (added in version 1.3.0)
+void reportRecovery(const ITUSB2Device &device)
+{
+    ITUSB2Device::Counters counters = device.counters();
+    if (counters.retries > 0 || counters.reconnects > 0) {
+        std::cerr << "Recovered from transient failures: " << counters.retries << " retr" << (counters.retries == 1 ? "y" : "ies") << ", " << counters.reconnects << " reconnect" << (counters.reconnects == 1 ? "" : "s") << ".\n";
+    }
+}
+
+// Returns a record containing the given device status, using the same field names in all tools
+Record statusRecord(const ITUSB2Device::Status &status)
+{
+    return Record().boolean("power", status.up).boolean("data", status.ud).boolean("connected", status.cd).boolean("high_speed", status.hs).number("current_ma", status.current, 1).boolean("fault", status.oc);
+}
@@ -0,0 +1,50 @@
+/* ITUSB2 command functions - Version 1.1.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+// Includes
+#include <ostream>
+#include <string>
+#include <vector>
+#include "itusb2device.h"
+#include "output.h"
+#include "worker.h"
+
+// Definitions
+const int EXIT_USERERR = 2;  // Exit status value to indicate a command usage error
+
+// Function prototypes
+int commandFormat(const std::vector<std::string> &args, size_t &nparams);
+int commandFormat(const std::vector<std::string> &args);
+int commandMain(const std::string &command, int argc, char **argv);
+int executeCommand(ITUSB2Device &device, const std::vector<std::string> &args, std::ostream &out, std::ostream &err, DeviceWorker *worker = nullptr);
+bool isSwitchCommand(const std::vector<std::string> &args);
+int openDevice(ITUSB2Device &device, const std::string &serial);
+void printOpenError(int err, Output &output);
+void printUsageError(int format, const std::string &usage);
+void reportDeviceErrors(const ITUSB2Device &device, const std::string &errstr, Output &output);
+void reportRealtime(const ITUSB2Device &device);
+void reportRecovery(const ITUSB2Device &device);
+int runCommand(const std::string &serial, const std::vector<std::string> &args);
+Record statusRecord(const ITUSB2Device::Status &status);
+
+#endif  // COMMANDS_H
@@ -1,4 +1,4 @@
-/* CP2130 class - Version 1.2.2
+/* CP2130 class - Version 1.3.0
    Copyright (c) 2021-2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -19,9 +19,16 @@
 
 
 // Includes
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <sstream>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "cp2130.h"
 extern "C" {
 #include "libusb-extra.h"
@@ -29,12 +36,133 @@ extern "C" {
 
 // Definitions
 const unsigned int TR_TIMEOUT = 500;  // Transfer timeout in milliseconds
+const char SYSFS_USB_DEVICES[] = "/sys/bus/usb/devices";  // Directory where the kernel exposes the attributes of each USB device (added in version 1.3.0)
+const char USBFS_NODES[] = "/dev/bus/usb";                // Directory containing the usbfs device nodes, organized by bus number (added in version 1.3.0)
+
+// Specific to resetAndReopen() (added in version 1.3.0)
+const std::chrono::milliseconds RESET_POLL(2);  // Interval between checks for the departure and the return of the device [2ms]
+const unsigned int RESET_PROBE_TIMEOUT = 100;   // Timeout of the transfers that probe the departure of the device, in milliseconds
 
 // Specific to getDescGeneric() and writeDescGeneric() (added in version 1.1.0)
 const uint16_t DESC_TBLSIZE = 0x0040;          // Descriptor table size, including preamble [64]
 const size_t DESC_MAXIDX = DESC_TBLSIZE - 2;   // Maximum usable index [62]
 const size_t DESC_IDXINCR = DESC_TBLSIZE - 1;  // Index increment or step between table preambles [63]
 
+// State of an asynchronous transfer, which lives from submission until its callback returns (added in version 1.3.0)
+struct PendingTransfer {
+    CP2130 *device;
+    CP2130::TransferCallback callback;
+    std::vector<unsigned char> buffer;  // Includes the setup packet, for control transfers
+    bool control;
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint8_t endpointAddr;
+};
+
+// Returns the error message for a failed bulk transfer (added as a refactor in version 1.3.0)
+static std::string bulkErrorMessage(uint8_t endpointAddr)
+{
+    std::ostringstream stream;
+    if (endpointAddr < 0x80) {
+        stream << "Failed bulk OUT transfer to endpoint "
+               << (0x0F & endpointAddr)
+               << " (address 0x"
+               << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
+               << ")." << std::endl;
+    } else {
+        stream << "Failed bulk IN transfer from endpoint "
+               << (0x0F & endpointAddr)
+               << " (address 0x"
+               << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
+               << ")." << std::endl;
+    }
+    return stream.str();
+}
+
+// Returns the error message for a failed control transfer (added as a refactor in version 1.3.0)
+static std::string controlErrorMessage(uint8_t bmRequestType, uint8_t bRequest)
+{
+    std::ostringstream stream;
+    stream << "Failed control transfer (0x"
+           << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(bmRequestType)
+           << ", 0x"
+           << std::setw(2) << static_cast<int>(bRequest)
+           << ")." << std::endl;
+    return stream.str();
+}
+
+// Returns true if the given control request can be repeated without side effects, in which case it can be retried if it fails (added in version 1.3.0)
+// Every request that gets a value is idempotent, and so are the requests that set a value, except the ones that reset the device, stop a ReadWithRTR command or write to the OTP ROM
+static bool isIdempotent(uint8_t bmRequestType, uint8_t bRequest)
+{
+    return bmRequestType == CP2130::GET || bRequest == CP2130::SET_GPIO_VALUES || bRequest == CP2130::SET_GPIO_MODE_AND_LEVEL || bRequest == CP2130::SET_GPIO_CHIP_SELECT || bRequest == CP2130::SET_SPI_WORD || bRequest == CP2130::SET_SPI_DELAY || bRequest == CP2130::SET_FULL_THRESHOLD || bRequest == CP2130::SET_EVENT_COUNTER || bRequest == CP2130::SET_CLOCK_DIVIDER;
+}
+
+// Converts a duration to an integer number of microseconds (added in version 1.3.0)
+static uint32_t toMicroseconds(const std::chrono::steady_clock::duration &duration)
+{
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+// Returns the first line of the given sysfs attribute file, or an empty string if it cannot be read (added in version 1.3.0)
+static std::string readAttribute(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+// Private callback that completes an asynchronous transfer, called by libusb from the thread that handles the events of the device context (added in version 1.3.0)
+void LIBUSB_CALL CP2130::completeTransfer(libusb_transfer *transfer)
+{
+    PendingTransfer *pending = static_cast<PendingTransfer *>(transfer->user_data);
+    int errcnt = 0;
+    std::string errstr;
+    std::vector<uint8_t> data;
+    size_t offset = pending->control ? LIBUSB_CONTROL_SETUP_SIZE : 0;
+    size_t expected = pending->buffer.size() - offset;
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED || (pending->control && static_cast<size_t>(transfer->actual_length) != expected) || (!pending->control && pending->endpointAddr < 0x80 && static_cast<size_t>(transfer->actual_length) != expected)) {  // As with the synchronous transfers, a short control transfer or a short bulk OUT transfer is a failure
+        ++errcnt;
+        ++pending->device->transferErrors_;
+        errstr += pending->control ? controlErrorMessage(pending->bmRequestType, pending->bRequest) : bulkErrorMessage(pending->endpointAddr);
+        if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE || transfer->status == LIBUSB_TRANSFER_ERROR || transfer->status == LIBUSB_TRANSFER_STALL) {  // Equivalent to the errors that are taken as a disconnection by the synchronous transfers
+            pending->device->disconnected_ = true;
+        }
+    } else if (pending->control ? (pending->bmRequestType & LIBUSB_ENDPOINT_IN) != 0 : pending->endpointAddr >= 0x80) {
+        data.assign(pending->buffer.begin() + offset, pending->buffer.begin() + offset + transfer->actual_length);
+    }
+    libusb_free_transfer(transfer);
+    pending->callback(data, errcnt, errstr);
+    delete pending;
+}
+
+// Private helper that claims the interface of a device that was just opened (added as a refactor in version 1.3.0)
+// In case of failure, the device is closed and libusb is deinitialized
+int CP2130::claimInterface()
+{
+    int retval;
+    if (libusb_kernel_driver_active(handle_, 0) == 1) {  // If a kernel driver is active on the interface
+        libusb_detach_kernel_driver(handle_, 0);  // Detach the kernel driver
+        kernelWasAttached_ = true;  // Flag that the kernel driver was attached
+    } else {
+        kernelWasAttached_ = false;  // The kernel driver was not attached
+    }
+    if (libusb_claim_interface(handle_, 0) != 0) {  // Claim the interface. In case of failure
+        if (kernelWasAttached_) {  // If a kernel driver was attached to the interface before
+            libusb_attach_kernel_driver(handle_, 0);  // Reattach the kernel driver
+        }
+        libusb_close(handle_);  // Close the device
+        libusb_exit(context_);  // Deinitialize libusb
+        handle_ = nullptr;  // Required to mark the device as closed
+        retval = ERROR_BUSY;
+    } else {
+        disconnected_ = false;  // Note that this flag is never assumed to be true for a device that was never opened - See constructor for details!
+        retval = SUCCESS;
+    }
+    return retval;
+}
+
 // Private generic procedure used to get any descriptor (added as a refactor in version 1.1.0)
 std::u16string CP2130::getDescGeneric(uint8_t command, int &errcnt, std::string &errstr)
 {
@@ -65,6 +193,75 @@ std::u16string CP2130::getDescGeneric(uint8_t command, int &errcnt, std::string
     return descriptor;
 }
 
+// Private helper that opens the given usbfs device node, and wraps it as done by wrapDevice() (added as a refactor in version 1.3.0)
+// The device node is owned by the object, and it is closed by close()
+int CP2130::openNode(const std::string &node, uint16_t vid, uint16_t pid, const std::string &serial)
+{
+    int retval;
+    int fd = ::open(node.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {  // In case of failure to open the device node (e.g., due to insufficient permissions)
+        retval = ERROR_NOT_FOUND;  // As with open(), a device that cannot be opened is reported as not found
+    } else {
+        retval = wrapDevice(fd, vid, pid, serial);
+        if (retval == SUCCESS) {
+            ownedFD_ = fd;  // The device node is closed by close()
+        } else {
+            ::close(fd);
+        }
+    }
+    return retval;
+}
+
+// Private helper that opens the device referred to by the given usbfs file descriptor, on a libusb context that does not enumerate devices (added in version 1.3.0)
+// The device is only accepted if it has the given VID, PID and, if specified, serial number - Otherwise, ERROR_NOT_FOUND is returned
+int CP2130::wrapDevice(int fd, uint16_t vid, uint16_t pid, const std::string &serial)
+{
+    int retval;
+#if LIBUSB_API_VERSION >= 0x01000108
+#if LIBUSB_API_VERSION >= 0x0100010A
+    libusb_init_option option = {LIBUSB_OPTION_NO_DEVICE_DISCOVERY, {0}};
+    int err = libusb_init_context(&context_, &option, 1);  // Device discovery is disabled for this context only
+#elif LIBUSB_API_VERSION >= 0x01000109
+    libusb_set_option(nullptr, LIBUSB_OPTION_NO_DEVICE_DISCOVERY);  // Before libusb 1.0.27, this applies to every context initialized afterwards by the process
+    int err = libusb_init(&context_);
+#else
+    libusb_set_option(nullptr, LIBUSB_OPTION_WEAK_AUTHORITY);  // Libusb 1.0.24 only provides this option under its original name, which was later renamed to LIBUSB_OPTION_NO_DEVICE_DISCOVERY
+    int err = libusb_init(&context_);
+#endif
+    if (err != 0) {  // In case of failure to initialize libusb
+        retval = ERROR_INIT;
+    } else {
+        libusb_device_descriptor desc;
+        if (libusb_wrap_sys_device(context_, static_cast<intptr_t>(fd), &handle_) != 0) {
+            handle_ = nullptr;
+        } else if (libusb_get_device_descriptor(libusb_get_device(handle_), &desc) != 0 || desc.idVendor != vid || desc.idProduct != pid) {  // If the descriptor cannot be retrieved, or if either the VID or the PID does not correspond to the respective given value
+            libusb_close(handle_);
+            handle_ = nullptr;
+        } else if (!serial.empty()) {
+            unsigned char serialDesc[256];
+            int length = libusb_get_string_descriptor_ascii(handle_, desc.iSerialNumber, serialDesc, static_cast<int>(sizeof(serialDesc)));
+            if (length < 0 || serial != std::string(reinterpret_cast<char *>(serialDesc), static_cast<size_t>(length))) {  // If the serial number cannot be retrieved, or does not match
+                libusb_close(handle_);
+                handle_ = nullptr;
+            }
+        }
+        if (handle_ == nullptr) {  // If the device could not be wrapped, or is not the expected one
+            libusb_exit(context_);  // Deinitialize libusb
+            retval = ERROR_NOT_FOUND;
+        } else {
+            retval = claimInterface();
+        }
+    }
+#else
+    (void)fd;
+    (void)vid;
+    (void)pid;
+    (void)serial;
+    retval = ERROR_INIT;  // Wrapping a file descriptor requires libusb 1.0.24 or later
+#endif
+    return retval;
+}
+
 // Private generic procedure used to write any descriptor (added as a refactor in version 1.1.0)
 void CP2130::writeDescGeneric(const std::u16string &descriptor, uint8_t command, int &errcnt, std::string &errstr)
 {
@@ -88,6 +285,18 @@ void CP2130::writeDescGeneric(const std::u16string &descriptor, uint8_t command,
     }
 }
 
+// "Equal to" operator for DeviceLocation
+bool CP2130::DeviceLocation::operator ==(const CP2130::DeviceLocation &other) const
+{
+    return serial == other.serial && bus == other.bus && address == other.address && port == other.port;
+}
+
+// "Not equal to" operator for DeviceLocation
+bool CP2130::DeviceLocation::operator !=(const CP2130::DeviceLocation &other) const
+{
+    return !(operator ==(other));
+}
+
 // "Equal to" operator for EventCounter
 bool CP2130::EventCounter::operator ==(const CP2130::EventCounter &other) const
 {
@@ -148,6 +357,30 @@ const uint8_t &CP2130::PROMConfig::operator [](size_t index) const  // For corre
     return blocks[index / PROM_BLOCK_SIZE][index % PROM_BLOCK_SIZE];
 }
 
+// "Equal to" operator for ResetTiming
+bool CP2130::ResetTiming::operator ==(const CP2130::ResetTiming &other) const
+{
+    return departure == other.departure && ready == other.ready;
+}
+
+// "Not equal to" operator for ResetTiming
+bool CP2130::ResetTiming::operator !=(const CP2130::ResetTiming &other) const
+{
+    return !(operator ==(other));
+}
+
+// "Equal to" operator for RetryPolicy
+bool CP2130::RetryPolicy::operator ==(const CP2130::RetryPolicy &other) const
+{
+    return retries == other.retries && initialDelay == other.initialDelay && maxDelay == other.maxDelay;
+}
+
+// "Not equal to" operator for RetryPolicy
+bool CP2130::RetryPolicy::operator !=(const CP2130::RetryPolicy &other) const
+{
+    return !(operator ==(other));
+}
+
 // "Equal to" operator for SiliconVersion
 bool CP2130::SiliconVersion::operator ==(const CP2130::SiliconVersion &other) const
 {
@@ -200,7 +433,16 @@ CP2130::CP2130() :
     context_(nullptr),
     handle_(nullptr),
     disconnected_(false),
-    kernelWasAttached_(false)
+    kernelWasAttached_(false),
+    ownedFD_(-1),
+    direct_(false),
+    bulkTransfers_(0),
+    controlTransfers_(0),
+    transferErrors_(0),
+    retries_(0),
+    maxRetries_(0),
+    retryDelay_(0),
+    maxRetryDelay_(0)
 {
 }
 
@@ -209,6 +451,24 @@ CP2130::~CP2130()
     close();  // The destructor is used to close the device, and this is essential so the device can be freed when the parent object is destroyed
 }
 
+// Returns the number of bulk transfers issued since the counters were last reset (added in version 1.3.0)
+uint64_t CP2130::bulkTransfers() const
+{
+    return bulkTransfers_;
+}
+
+// Returns the libusb context of the device, so that its events can be handled by an event loop, or a null pointer if the device is not open (added in version 1.3.0)
+libusb_context *CP2130::context() const
+{
+    return isOpen() ? context_ : nullptr;
+}
+
+// Returns the number of control transfers issued since the counters were last reset (added in version 1.3.0)
+uint64_t CP2130::controlTransfers() const
+{
+    return controlTransfers_;
+}
+
 // Diagnostic function used to verify if the device has been disconnected
 bool CP2130::disconnected() const
 {
@@ -221,6 +481,31 @@ bool CP2130::isOpen() const
     return handle_ != nullptr;  // Returns true if the device is open, or false otherwise
 }
 
+// Returns the number of control transfers that were retried since the counters were last reset (added in version 1.3.0)
+uint64_t CP2130::retries() const
+{
+    return retries_;
+}
+
+// Returns the retry policy in effect (added in version 1.3.0)
+CP2130::RetryPolicy CP2130::retryPolicy() const
+{
+    RetryPolicy policy = {maxRetries_, retryDelay_, maxRetryDelay_};
+    return policy;
+}
+
+// Returns the number of failed transfers since the counters were last reset (added in version 1.3.0)
+uint64_t CP2130::transferErrors() const
+{
+    return transferErrors_;
+}
+
+// Returns the number of USB transfers (control and bulk) issued since the counters were last reset, which is useful for profiling (added in version 1.3.0)
+uint64_t CP2130::transfers() const
+{
+    return bulkTransfers_ + controlTransfers_;
+}
+
 // Safe bulk transfer
 void CP2130::bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred, int &errcnt, std::string &errstr)
 {
@@ -228,24 +513,12 @@ void CP2130::bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length,
         ++errcnt;
         errstr += "In bulkTransfer(): device is not open.\n";  // Program logic error
     } else {
+        ++bulkTransfers_;
         int result = libusb_bulk_transfer(handle_, endpointAddr, data, length, transferred, TR_TIMEOUT);
         if (result != 0 || (transferred != nullptr && *transferred != length)) {  // The number of transferred bytes is also verified, as long as a valid (non-null) pointer is passed via "transferred"
             ++errcnt;
-            std::ostringstream stream;
-            if (endpointAddr < 0x80) {
-                stream << "Failed bulk OUT transfer to endpoint "
-                       << (0x0F & endpointAddr)
-                       << " (address 0x"
-                       << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
-                       << ")." << std::endl;
-            } else {
-                stream << "Failed bulk IN transfer from endpoint "
-                       << (0x0F & endpointAddr)
-                       << " (address 0x"
-                       << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(endpointAddr)
-                       << ")." << std::endl;
-            }
-            errstr += stream.str();
+            ++transferErrors_;
+            errstr += bulkErrorMessage(endpointAddr);
             if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO) {  // Note that libusb_bulk_transfer() may return "LIBUSB_ERROR_IO" [-1] on device disconnect
                 disconnected_ = true;  // This reports that the device has been disconnected
             }
@@ -264,6 +537,10 @@ void CP2130::close()
         libusb_close(handle_);  // Close the device
         libusb_exit(context_);  // Deinitialize libusb
         handle_ = nullptr;  // Required to mark the device as closed
+        if (ownedFD_ >= 0) {  // If the device was opened via its device node, the node is closed as well
+            ::close(ownedFD_);
+            ownedFD_ = -1;
+        }
     }
 }
 
@@ -324,16 +601,24 @@ void CP2130::controlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t w
         ++errcnt;
         errstr += "In controlTransfer(): device is not open.\n";  // Program logic error
     } else {
-        int result = libusb_control_transfer(handle_, bmRequestType, bRequest, wValue, wIndex, data, wLength, TR_TIMEOUT);
+        int retriesLeft = isIdempotent(bmRequestType, bRequest) ? maxRetries_ : 0;  // Since version 1.3.0, idempotent requests are retried according to the retry policy
+        std::chrono::microseconds delay = retryDelay_;
+        int result;
+        while (true) {
+            ++controlTransfers_;
+            result = libusb_control_transfer(handle_, bmRequestType, bRequest, wValue, wIndex, data, wLength, TR_TIMEOUT);
+            if (result == wLength || result == LIBUSB_ERROR_NO_DEVICE || retriesLeft == 0) {  // A device that is gone is not retried, since it must be reopened first
+                break;
+            }
+            --retriesLeft;
+            ++retries_;
+            std::this_thread::sleep_for(delay);
+            delay = std::min(2 * delay, maxRetryDelay_);  // Bounded exponential backoff
+        }
         if (result != wLength) {
             ++errcnt;
-            std::ostringstream stream;
-            stream << "Failed control transfer (0x"
-                   << std::hex << std::setfill ('0') << std::setw(2) << static_cast<int>(bmRequestType)
-                   << ", 0x"
-                   << std::setw(2) << static_cast<int>(bRequest)
-                   << ")." << std::endl;
-            errstr += stream.str();
+            ++transferErrors_;
+            errstr += controlErrorMessage(bmRequestType, bRequest);
             if (result == LIBUSB_ERROR_NO_DEVICE || result == LIBUSB_ERROR_IO || result == LIBUSB_ERROR_PIPE) {  // Note that libusb_control_transfer() may return "LIBUSB_ERROR_IO" [-1] or "LIBUSB_ERROR_PIPE" [-9] on device disconnect
                 disconnected_ = true;  // This reports that the device has been disconnected
             }
@@ -706,24 +991,74 @@ int CP2130::open(uint16_t vid, uint16_t pid, const std::string &serial)
             libusb_exit(context_);  // Deinitialize libusb
             retval = ERROR_NOT_FOUND;
         } else {  // If the device is successfully opened and a handle obtained
-            if (libusb_kernel_driver_active(handle_, 0) == 1) {  // If a kernel driver is active on the interface
-                libusb_detach_kernel_driver(handle_, 0);  // Detach the kernel driver
-                kernelWasAttached_ = true;  // Flag that the kernel driver was attached
-            } else {
-                kernelWasAttached_ = false;  // The kernel driver was not attached
-            }
-            if (libusb_claim_interface(handle_, 0) != 0) {  // Claim the interface. In case of failure
-                if (kernelWasAttached_) {  // If a kernel driver was attached to the interface before
-                    libusb_attach_kernel_driver(handle_, 0);  // Reattach the kernel driver
-                }
-                libusb_close(handle_);  // Close the device
-                libusb_exit(context_);  // Deinitialize libusb
-                handle_ = nullptr;  // Required to mark the device as closed
-                retval = ERROR_BUSY;
-            } else {
-                disconnected_ = false;  // Note that this flag is never assumed to be true for a device that was never opened - See constructor for details!
-                retval = SUCCESS;
-            }
+            retval = claimInterface();  // Since version 1.3.0, the interface is claimed by claimInterface()
+            direct_ = false;
+        }
+    }
+    return retval;
+}
+
+// Opens the device having the given VID, PID and serial number, without enumerating the USB devices on the host (added in version 1.3.0)
+// The device node is located via sysfs and wrapped with libusb_wrap_sys_device(), so that the time taken to open the device does not depend on how many USB devices are connected
+// If no serial number is given, if the device node cannot be located (e.g., sysfs is not available), or if the version of libusb does not support wrapping, this falls back to open()
+// Without a serial number, open() is always used, so that the same device is picked as by open() and listDevices(), instead of the first one in the sysfs directory order
+// Note that, before libusb 1.0.27, device discovery stays disabled for any libusb context the process initializes afterwards, including the one used by listDevices()
+int CP2130::openDirect(uint16_t vid, uint16_t pid, const std::string &serial)
+{
+    bool wasOpen = isOpen();
+    int retval;
+#if LIBUSB_API_VERSION >= 0x01000108
+    std::string node;
+    if (wasOpen || serial.empty() || (node = findDeviceNode(vid, pid, serial)).empty()) {
+        retval = open(vid, pid, serial);
+    } else {
+        retval = openNode(node, vid, pid, serial);
+    }
+#else
+    retval = open(vid, pid, serial);
+#endif
+    if (retval == SUCCESS && !wasOpen) {
+        direct_ = true;  // Even if this fell back to open(), the device should be reopened in the same way
+    }
+    return retval;
+}
+
+// Opens the device at the given location, as obtained from locateDevices(), without enumerating the USB devices on the host again (added in version 1.3.0)
+// The device must have the given VID, PID and, if the location specifies one, serial number - Otherwise (e.g., if the device was replaced), ERROR_NOT_FOUND is returned
+// This is meant for opening several devices after a single enumeration - Before libusb 1.0.27, this falls back to open(), since disabling device discovery would then affect the whole process
+int CP2130::openLocation(const DeviceLocation &location, uint16_t vid, uint16_t pid)
+{
+    bool wasOpen = isOpen();
+    int retval;
+#if LIBUSB_API_VERSION >= 0x0100010A
+    if (wasOpen) {  // See open() for details
+        retval = SUCCESS;
+    } else {
+        std::ostringstream stream;
+        stream << USBFS_NODES << "/" << std::setfill('0') << std::setw(3) << static_cast<unsigned>(location.bus) << "/" << std::setw(3) << static_cast<unsigned>(location.address);
+        retval = openNode(stream.str(), vid, pid, location.serial);
+    }
+#else
+    retval = open(vid, pid, location.serial);
+#endif
+    if (retval == SUCCESS && !wasOpen) {
+        direct_ = false;  // Reopened by serial number via open(), since the address changes when the device re-enumerates, and openDirect() is not meant for processes that operate several devices
+    }
+    return retval;
+}
+
+// Opens the device referred to by the given usbfs file descriptor, typically inherited from a launcher process (added in version 1.3.0)
+// The device must have the given VID, PID and, if specified, serial number - Otherwise, ERROR_NOT_FOUND is returned
+// The file descriptor remains owned by the caller, and is not closed by close()
+int CP2130::openFD(int fd, uint16_t vid, uint16_t pid, const std::string &serial)
+{
+    int retval;
+    if (isOpen()) {  // See open() for details
+        retval = SUCCESS;
+    } else {
+        retval = wrapDevice(fd, vid, pid, serial);
+        if (retval == SUCCESS) {
+            direct_ = true;
         }
     }
     return retval;
@@ -735,6 +1070,71 @@ void CP2130::reset(int &errcnt, std::string &errstr)
     controlTransfer(SET, RESET_DEVICE, 0x0000, 0x0000, nullptr, RESET_DEVICE_WLEN, errcnt, errstr);
 }
 
+// Issues a reset to the CP2130, waits for it to re-enumerate and reopens it, returning the time taken to leave the bus and to become ready again (added in version 1.3.0)
+// The departure of the device is detected by probing it every 2ms, and its return by trying to reopen it by serial number at the same rate, in the same way it was opened (see openDirect())
+// Both phases must complete within the given timeout, measured from the reset request - If the device does not come back in time, it is left closed
+// The transfer counters and the retry policy are kept
+CP2130::ResetTiming CP2130::resetAndReopen(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr)
+{
+    ResetTiming timing = {0, 0};
+    libusb_device_descriptor descriptor;
+    if (!isOpen()) {
+        ++errcnt;
+        errstr += "In resetAndReopen(): device is not open.\n";  // Program logic error
+    } else if (libusb_get_device_descriptor(libusb_get_device(handle_), &descriptor) != 0) {
+        ++errcnt;
+        errstr += "In resetAndReopen(): Failed to get device descriptor.\n";
+    } else {
+        int preverrcnt = errcnt;
+        std::u16string serialdesc = getSerialDesc(errcnt, errstr);  // The device is found again by its serial number, even if it was opened without one
+        if (errcnt == preverrcnt) {
+            std::string serial(serialdesc.begin(), serialdesc.end());  // Serial numbers are plain ASCII
+            bool direct = direct_;  // Note that a device opened by openFD() is reopened by openDirect(), since the file descriptor refers to the device that is gone
+            int reseterrcnt = 0;
+            std::string reseterrstr;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();  // All timings are based on the monotonic clock
+            std::chrono::steady_clock::time_point deadline = start + timeout;
+            reset(reseterrcnt, reseterrstr);  // Errors are only reported if the device does not go away, since the CP2130 may reset before completing the request
+            bool gone = false;  // The device is probed even if the reset request failed, since transfer errors other than LIBUSB_ERROR_NO_DEVICE do not mean that it already left the bus (see controlTransfer())
+            while (!gone && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(RESET_POLL);
+                unsigned char controlBufferIn[GET_READONLY_VERSION_WLEN];
+                gone = libusb_control_transfer(handle_, GET, GET_READONLY_VERSION, 0x0000, 0x0000, controlBufferIn, GET_READONLY_VERSION_WLEN, RESET_PROBE_TIMEOUT) == LIBUSB_ERROR_NO_DEVICE;  // Probes are not counted as transfers, and any error other than LIBUSB_ERROR_NO_DEVICE is expected while the device resets
+            }
+            if (!gone) {
+                errcnt += reseterrcnt;
+                errstr += reseterrstr;
+                ++errcnt;
+                errstr += "In resetAndReopen(): Device did not disconnect after reset.\n";
+            } else {
+                timing.departure = toMicroseconds(std::chrono::steady_clock::now() - start);
+                close();
+                int err = ERROR_NOT_FOUND;
+                while ((err == ERROR_NOT_FOUND || err == ERROR_BUSY) && std::chrono::steady_clock::now() < deadline) {  // The device node may appear before access to it is granted, and the interface may be briefly claimed by another process during enumeration, hence ERROR_BUSY is also transient
+                    std::this_thread::sleep_for(RESET_POLL);
+                    err = direct ? openDirect(descriptor.idVendor, descriptor.idProduct, serial) : open(descriptor.idVendor, descriptor.idProduct, serial);
+                }
+                if (err == SUCCESS) {
+                    timing.ready = toMicroseconds(std::chrono::steady_clock::now() - start);
+                } else {
+                    ++errcnt;
+                    errstr += "In resetAndReopen(): Could not reopen device after reset.\n";
+                }
+            }
+        }
+    }
+    return timing;
+}
+
+// Clears the transfer counters, which are otherwise kept when the device is closed and reopened, so that they cover any reconnections (added in version 1.3.0)
+void CP2130::resetCounters()
+{
+    bulkTransfers_ = 0;
+    controlTransfers_ = 0;
+    transferErrors_ = 0;
+    retries_ = 0;
+}
+
 // Enables the chip select of the target channel, disabling any others
 void CP2130::selectCS(uint8_t channel, int &errcnt, std::string &errstr)
 {
@@ -854,6 +1254,16 @@ void CP2130::setGPIOs(uint16_t bmValues, uint16_t bmMask, int &errcnt, std::stri
     controlTransfer(SET, SET_GPIO_VALUES, 0x0000, 0x0000, controlBufferOut, SET_GPIO_VALUES_WLEN, errcnt, errstr);
 }
 
+// Sets the policy according to which failed control transfers are retried (added in version 1.3.0)
+// Only idempotent requests are retried, and only if they fail for reasons other than the device being gone (bulk transfers are never retried, since a repeated SPI transfer is not equivalent to the original one)
+// Important: the policy should not be changed while another thread operates the device!
+void CP2130::setRetryPolicy(const RetryPolicy &policy)
+{
+    maxRetries_ = policy.retries;
+    retryDelay_ = policy.initialDelay;
+    maxRetryDelay_ = policy.maxDelay;
+}
+
 // Requests and reads the given number of bytes from the SPI bus, and then returns a vector
 // This is the prefered method of reading from the bus, if both endpoint addresses are known
 std::vector<uint8_t> CP2130::spiRead(uint32_t bytesToRead, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr)
@@ -980,6 +1390,60 @@ void CP2130::stopRTR(int &errcnt, std::string &errstr)
     controlTransfer(SET, SET_RTR_STOP, 0x0000, 0x0000, controlBufferOut, SET_RTR_STOP_WLEN, errcnt, errstr);
 }
 
+// Submits an asynchronous bulk transfer, calling back once it completes (added in version 1.3.0)
+// For an IN endpoint, the size of the given vector sets the number of bytes to read, and its contents are ignored
+// Important: the callback is called while libusb events are handled for this device, or before this function returns, if the transfer could not be submitted
+void CP2130::submitBulkTransfer(uint8_t endpointAddr, const std::vector<uint8_t> &data, const TransferCallback &callback)
+{
+    if (!isOpen()) {
+        callback(std::vector<uint8_t>(), 1, "In submitBulkTransfer(): device is not open.\n");  // Program logic error
+    } else {
+        PendingTransfer *pending = new PendingTransfer{this, callback, std::vector<unsigned char>(data.begin(), data.end()), false, 0x00, 0x00, endpointAddr};
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(transfer, handle_, endpointAddr, pending->buffer.data(), static_cast<int>(pending->buffer.size()), completeTransfer, pending, TR_TIMEOUT);
+        ++bulkTransfers_;
+        int result = libusb_submit_transfer(transfer);
+        if (result != 0) {
+            ++transferErrors_;
+            if (result == LIBUSB_ERROR_NO_DEVICE) {
+                disconnected_ = true;
+            }
+            libusb_free_transfer(transfer);
+            delete pending;
+            callback(std::vector<uint8_t>(), 1, bulkErrorMessage(endpointAddr));
+        }
+    }
+}
+
+// Submits an asynchronous control transfer, calling back once it completes (added in version 1.3.0)
+// For a Device-to-Host request, "data" is ignored, and the data stage received is passed to the callback instead
+// Important: the callback is called while libusb events are handled for this device, or before this function returns, if the transfer could not be submitted
+void CP2130::submitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const std::vector<uint8_t> &data, uint16_t wLength, const TransferCallback &callback)
+{
+    if (!isOpen()) {
+        callback(std::vector<uint8_t>(), 1, "In submitControlTransfer(): device is not open.\n");  // Program logic error
+    } else {
+        PendingTransfer *pending = new PendingTransfer{this, callback, std::vector<unsigned char>(LIBUSB_CONTROL_SETUP_SIZE + wLength), true, bmRequestType, bRequest, 0x00};
+        libusb_fill_control_setup(pending->buffer.data(), bmRequestType, bRequest, wValue, wIndex, wLength);
+        if ((bmRequestType & LIBUSB_ENDPOINT_IN) == 0) {
+            std::copy(data.begin(), data.begin() + std::min<size_t>(data.size(), wLength), pending->buffer.begin() + LIBUSB_CONTROL_SETUP_SIZE);
+        }
+        libusb_transfer *transfer = libusb_alloc_transfer(0);
+        libusb_fill_control_transfer(transfer, handle_, pending->buffer.data(), completeTransfer, pending, TR_TIMEOUT);
+        ++controlTransfers_;
+        int result = libusb_submit_transfer(transfer);
+        if (result != 0) {
+            ++transferErrors_;
+            if (result == LIBUSB_ERROR_NO_DEVICE) {
+                disconnected_ = true;
+            }
+            libusb_free_transfer(transfer);
+            delete pending;
+            callback(std::vector<uint8_t>(), 1, controlErrorMessage(bmRequestType, bRequest));
+        }
+    }
+}
+
 // This procedure is used to lock fields in the CP2130 OTP ROM - Use with care!
 void CP2130::writeLockWord(uint16_t word, int &errcnt, std::string &errstr)
 {
@@ -1073,10 +1537,46 @@ void CP2130::writeUSBConfig(const USBConfig &config, uint8_t mask, int &errcnt,
     controlTransfer(SET, SET_USB_CONFIG, PROM_WRITE_KEY, 0x0000, controlBufferOut, SET_USB_CONFIG_WLEN, errcnt, errstr);
 }
 
+// Helper function that returns the path of the usbfs device node of the device having the given VID, PID and, optionally, the given serial number (added in version 1.3.0)
+// The attributes exposed by the kernel via sysfs are read instead of enumerating the devices with libusb, which would read the descriptors of every device - An empty string is returned if no such device is found
+std::string CP2130::findDeviceNode(uint16_t vid, uint16_t pid, const std::string &serial)
+{
+    std::string node;
+    DIR *dir = opendir(SYSFS_USB_DEVICES);
+    if (dir != nullptr) {
+        dirent *entry;
+        while (node.empty() && (entry = readdir(dir)) != nullptr) {
+            std::string name = entry->d_name;
+            if (name[0] != '.' && name.find(':') == std::string::npos) {  // Interfaces (e.g., "1-2:1.0") are skipped, since only devices have the attributes below
+                std::string path = std::string(SYSFS_USB_DEVICES) + "/" + name + "/";
+                if (std::strtoul(readAttribute(path + "idVendor").c_str(), nullptr, 16) == vid && std::strtoul(readAttribute(path + "idProduct").c_str(), nullptr, 16) == pid && (serial.empty() || readAttribute(path + "serial") == serial)) {
+                    std::ostringstream stream;
+                    stream << USBFS_NODES << "/" << std::setfill('0') << std::setw(3) << std::strtoul(readAttribute(path + "busnum").c_str(), nullptr, 10) << "/" << std::setw(3) << std::strtoul(readAttribute(path + "devnum").c_str(), nullptr, 10);
+                    node = stream.str();
+                }
+            }
+        }
+        closedir(dir);
+    }
+    return node;
+}
+
 // Helper function to list devices
 std::list<std::string> CP2130::listDevices(uint16_t vid, uint16_t pid, int &errcnt, std::string &errstr)
 {
+    std::vector<DeviceLocation> locations = locateDevices(vid, pid, errcnt, errstr);  // Since version 1.3.0, the list is obtained from locateDevices()
     std::list<std::string> devices;
+    for (const DeviceLocation &location : locations) {
+        devices.push_back(location.serial);
+    }
+    return devices;
+}
+
+// Helper function to list devices along with their location on the USB topology (added in version 1.3.0)
+// Each device is briefly opened, without claiming its interface, so that the serial number can be read - Devices in use are listed as well
+std::vector<CP2130::DeviceLocation> CP2130::locateDevices(uint16_t vid, uint16_t pid, int &errcnt, std::string &errstr)
+{
+    std::vector<DeviceLocation> devices;
     libusb_context *context;
     if (libusb_init(&context) != 0) {  // Initialize libusb. In case of failure
         ++errcnt;
@@ -1094,9 +1594,19 @@ std::list<std::string> CP2130::listDevices(uint16_t vid, uint16_t pid, int &errc
                     libusb_device_handle *handle;
                     if (libusb_open(devs[i], &handle) == 0) {  // Open the listed device. If successfull
                         unsigned char str_desc[256];
-                        libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, str_desc, static_cast<int>(sizeof(str_desc)));  // Get the serial number string in ASCII format
-                        devices.push_back(reinterpret_cast<char *>(str_desc));  // Add the serial number string to the list
+                        int length = libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, str_desc, static_cast<int>(sizeof(str_desc)));  // Get the serial number string in ASCII format
                         libusb_close(handle);  // Close the device
+                        DeviceLocation location;
+                        location.serial = length > 0 ? std::string(reinterpret_cast<char *>(str_desc), static_cast<size_t>(length)) : std::string();
+                        location.bus = libusb_get_bus_number(devs[i]);
+                        location.address = libusb_get_device_address(devs[i]);
+                        location.port = std::to_string(location.bus);
+                        uint8_t ports[7];  // The USB specification allows for up to seven tiers
+                        int nports = libusb_get_port_numbers(devs[i], ports, static_cast<int>(sizeof(ports)));
+                        for (int j = 0; j < nports; ++j) {
+                            location.port += (j == 0 ? "-" : ".") + std::to_string(ports[j]);
+                        }
+                        devices.push_back(location);
                     }
                 }
             }
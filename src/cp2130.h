@@ -1,4 +1,4 @@
-/* CP2130 class - Version 1.2.2
+/* CP2130 class - Version 1.3.0
    Copyright (c) 2021-2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -22,22 +22,38 @@
 #define CP2130_H
 
 // Includes
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <string>
 #include <vector>
 #include <libusb-1.0/libusb.h>
+#include "awaitable.h"
 
 class CP2130
 {
 private:
     libusb_context *context_;
     libusb_device_handle *handle_;
-    bool disconnected_, kernelWasAttached_;
-
+    std::atomic<bool> disconnected_;                                         // Atomic since version 1.3.0, so that it can be checked while another thread operates the device
+    bool kernelWasAttached_;
+    int ownedFD_;                                                            // File descriptor of the device node opened by openDirect(), or -1 (added in version 1.3.0)
+    bool direct_;                                                            // True if the device was opened by openDirect() or openFD(), so that resetAndReopen() reopens it without enumerating (added in version 1.3.0)
+    std::atomic<uint64_t> bulkTransfers_, controlTransfers_, transferErrors_;  // Likewise
+    std::atomic<uint64_t> retries_;                                          // Number of control transfers that were retried (added in version 1.3.0)
+    uint8_t maxRetries_;                                                     // Retry policy, as given to setRetryPolicy() (added in version 1.3.0)
+    std::chrono::microseconds retryDelay_, maxRetryDelay_;
+
+    int claimInterface();
     std::u16string getDescGeneric(uint8_t command, int &errcnt, std::string &errstr);
+    int openNode(const std::string &node, uint16_t vid, uint16_t pid, const std::string &serial);
+    int wrapDevice(int fd, uint16_t vid, uint16_t pid, const std::string &serial);
     void writeDescGeneric(const std::u16string &descriptor, uint8_t command, int &errcnt, std::string &errstr);
 
+    static void LIBUSB_CALL completeTransfer(libusb_transfer *transfer);
+
 public:
     // Class definitions
     static const uint16_t VID = 0x10C4;    // Default USB vendor ID
@@ -242,6 +258,16 @@ public:
     static const uint8_t PRIOREAD = 0x00;     // Value corresponding to data transfer with high priority read
     static const uint8_t PRIOWRITE = 0x01;    // Value corresponding to data transfer with high priority write
 
+    struct DeviceLocation {
+        std::string serial;  // Serial number
+        uint8_t bus;         // USB bus number
+        uint8_t address;     // USB device address
+        std::string port;    // Port path, following the naming used by the kernel (e.g., "1-2.4" for port 4 of a hub on port 2 of bus 1)
+
+        bool operator ==(const DeviceLocation &other) const;
+        bool operator !=(const DeviceLocation &other) const;
+    };
+
     struct EventCounter {
         bool overflow;   // Overflow flag
         uint8_t mode;    // GPIO.4/EVTCNTR pin mode (see the values applicable to PinConfig/getPinConfig()/writePinConfig())
@@ -282,6 +308,23 @@ public:
         const uint8_t &operator [](size_t index) const;
     };
 
+    struct ResetTiming {
+        uint32_t departure;  // Time from the reset request until the device was found to be gone, in microseconds
+        uint32_t ready;      // Time from the reset request until the device was reopened, in microseconds (zero if it was not)
+
+        bool operator ==(const ResetTiming &other) const;
+        bool operator !=(const ResetTiming &other) const;
+    };
+
+    struct RetryPolicy {
+        uint8_t retries;                         // Maximum number of times a failed idempotent control transfer is retried (zero disables retries)
+        std::chrono::microseconds initialDelay;  // Delay before the first retry, which is doubled before each subsequent retry
+        std::chrono::microseconds maxDelay;      // Upper bound of the delay between retries
+
+        bool operator ==(const RetryPolicy &other) const;
+        bool operator !=(const RetryPolicy &other) const;
+    };
+
     struct SiliconVersion {
         uint8_t maj;  // Major read-only version
         uint8_t min;  // Minor read-only version
@@ -326,11 +369,20 @@ public:
         bool operator !=(const USBConfig &other) const;
     };
 
+    typedef std::function<void(const std::vector<uint8_t> &data, int errcnt, const std::string &errstr)> TransferCallback;  // Called on completion of an asynchronous transfer, with the data received, if any (added in version 1.3.0)
+
     CP2130();
     ~CP2130();
 
+    uint64_t bulkTransfers() const;
+    libusb_context *context() const;
+    uint64_t controlTransfers() const;
     bool disconnected() const;
     bool isOpen() const;
+    uint64_t retries() const;
+    RetryPolicy retryPolicy() const;
+    uint64_t transferErrors() const;
+    uint64_t transfers() const;
 
     void bulkTransfer(uint8_t endpointAddr, unsigned char *data, int length, int *transferred, int &errcnt, std::string &errstr);
     void close();
@@ -375,7 +427,12 @@ public:
     bool isRTRActive(int &errcnt, std::string &errstr);
     void lockOTP(int &errcnt, std::string &errstr);
     int open(uint16_t vid, uint16_t pid, const std::string &serial = std::string());
+    int openDirect(uint16_t vid, uint16_t pid, const std::string &serial = std::string());
+    int openFD(int fd, uint16_t vid, uint16_t pid, const std::string &serial = std::string());
+    int openLocation(const DeviceLocation &location, uint16_t vid, uint16_t pid);
     void reset(int &errcnt, std::string &errstr);
+    ResetTiming resetAndReopen(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr);
+    void resetCounters();
     void selectCS(uint8_t channel, int &errcnt, std::string &errstr);
     void setClockDivider(uint8_t value, int &errcnt, std::string &errstr);
     void setEventCounter(const EventCounter &evcntr, int &errcnt, std::string &errstr);
@@ -392,6 +449,7 @@ public:
     void setGPIO9(bool value, int &errcnt, std::string &errstr);
     void setGPIO10(bool value, int &errcnt, std::string &errstr);
     void setGPIOs(uint16_t bmValues, uint16_t bmMask, int &errcnt, std::string &errstr);
+    void setRetryPolicy(const RetryPolicy &policy);
     std::vector<uint8_t> spiRead(uint32_t bytesToRead, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiRead(uint32_t bytesToRead, int &errcnt, std::string &errstr);
     void spiWrite(const std::vector<uint8_t> &data, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
@@ -399,6 +457,8 @@ public:
     std::vector<uint8_t> spiWriteRead(const std::vector<uint8_t> &data, uint8_t endpointInAddr, uint8_t endpointOutAddr, int &errcnt, std::string &errstr);
     std::vector<uint8_t> spiWriteRead(const std::vector<uint8_t> &data, int &errcnt, std::string &errstr);
     void stopRTR(int &errcnt, std::string &errstr);
+    void submitBulkTransfer(uint8_t endpointAddr, const std::vector<uint8_t> &data, const TransferCallback &callback);
+    void submitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const std::vector<uint8_t> &data, uint16_t wLength, const TransferCallback &callback);
     void writeLockWord(uint16_t word, int &errcnt, std::string &errstr);
     void writeManufacturerDesc(const std::u16string &manufacturer, int &errcnt, std::string &errstr);
     void writePinConfig(const PinConfig &config, int &errcnt, std::string &errstr);
@@ -407,7 +467,37 @@ public:
     void writeSerialDesc(const std::u16string &serial, int &errcnt, std::string &errstr);
     void writeUSBConfig(const USBConfig &config, uint8_t mask, int &errcnt, std::string &errstr);
 
+    static std::string findDeviceNode(uint16_t vid, uint16_t pid, const std::string &serial = std::string());
     static std::list<std::string> listDevices(uint16_t vid, uint16_t pid, int &errcnt, std::string &errstr);
+    static std::vector<DeviceLocation> locateDevices(uint16_t vid, uint16_t pid, int &errcnt, std::string &errstr);
+
+#if __cplusplus >= 202002L
+    // Awaitable versions of the asynchronous transfers, for use in coroutines (added in version 1.3.0)
+    Awaitable<std::vector<uint8_t>> submitBulkTransfer(uint8_t endpointAddr, const std::vector<uint8_t> &data);
+    Awaitable<std::vector<uint8_t>> submitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const std::vector<uint8_t> &data, uint16_t wLength);
+#endif
 };
 
+#if __cplusplus >= 202002L
+// Awaitable version of submitBulkTransfer() (added in version 1.3.0)
+inline Awaitable<std::vector<uint8_t>> CP2130::submitBulkTransfer(uint8_t endpointAddr, const std::vector<uint8_t> &data)
+{
+    return Awaitable<std::vector<uint8_t>>([this, endpointAddr, data](const Awaitable<std::vector<uint8_t>>::Resumer &resume) {
+        submitBulkTransfer(endpointAddr, data, [resume](const std::vector<uint8_t> &received, int errcnt, const std::string &errstr) {
+            resume({received, errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of submitControlTransfer() (added in version 1.3.0)
+inline Awaitable<std::vector<uint8_t>> CP2130::submitControlTransfer(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, const std::vector<uint8_t> &data, uint16_t wLength)
+{
+    return Awaitable<std::vector<uint8_t>>([this, bmRequestType, bRequest, wValue, wIndex, data, wLength](const Awaitable<std::vector<uint8_t>>::Resumer &resume) {
+        submitControlTransfer(bmRequestType, bRequest, wValue, wIndex, data, wLength, [resume](const std::vector<uint8_t> &received, int errcnt, const std::string &errstr) {
+            resume({received, errcnt, errstr});
+        });
+    });
+}
+#endif
+
 #endif  // CP2130_H
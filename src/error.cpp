@@ -1,4 +1,4 @@
-/* Error handling functions - Version 1.0.0
+/* Error handling functions - Version 1.1.0
    Copyright (c) 2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -24,10 +24,16 @@
 
 // Prints errors in separated lines (each error should be terminated with a newline character)
 void printErrors(const std::string &errstr)
+{
+    printErrors(errstr, std::cerr);
+}
+
+// Prints errors in separated lines to the given stream (added in version 1.1.0)
+void printErrors(const std::string &errstr, std::ostream &stream)
 {
     size_t lnend, lnstart = 0;
     while ((lnend = errstr.find('\n', lnstart)) != std::string::npos) {
-        std::cerr << "Error: " << errstr.substr(lnstart, lnend - lnstart + 1);  // This includes the newline character
+        stream << "Error: " << errstr.substr(lnstart, lnend - lnstart + 1);  // This includes the newline character
         lnstart = lnend + 1;
     }
 }
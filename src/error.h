@@ -1,4 +1,4 @@
-/* Error handling functions - Version 1.0.0
+/* Error handling functions - Version 1.1.0
    Copyright (c) 2022 Samuel Lourenço
 
    This library is free software: you can redistribute it and/or modify it
@@ -22,9 +22,11 @@
 #define ERROR_H
 
 // Includes
+#include <ostream>
 #include <string>
 
 // Function prototypes
 void printErrors(const std::string &errstr);
+void printErrors(const std::string &errstr, std::ostream &stream);
 
 #endif  // ERROR_H
@@ -0,0 +1,259 @@
+/* ITUSB2 event loop class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The event loop drives the asynchronous transfers of any number of devices from a single thread, along with timers and posted tasks
+// Since each device has its own libusb context, the loop waits on the file descriptors of every watched context at once, and only handles the events of the contexts that are ready
+// All callbacks, timers and posted tasks run on the loop thread, one at a time, so that no locking is required between them
+
+// Includes
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "eventloop.h"
+
+// Definitions
+const std::chrono::milliseconds FALLBACK_WAIT(10);  // Longest wait, used only if the wake-up pipe could not be created [10ms]
+
+// Context being waited on, and the range of its file descriptors in the poll set
+struct WatchedContext {
+    libusb_context *context;
+    size_t first;
+    size_t count;
+    std::chrono::steady_clock::time_point timeout;  // Time at which libusb needs to handle a transfer timeout, if any
+};
+
+// Body of the loop thread (private)
+void EventLoop::run()
+{
+    threadId_.store(std::this_thread::get_id());
+    std::vector<pollfd> fds;
+    std::vector<WatchedContext> watched;
+    while (!stop_.load(std::memory_order_acquire)) {
+        runPosted();
+        runTimers();
+        if (stop_.load(std::memory_order_acquire)) {
+            break;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = timers_.empty() ? std::chrono::steady_clock::time_point::max() : timers_.begin()->first;
+        fds.clear();
+        watched.clear();
+        if (wakeFds_[0] >= 0) {
+            fds.push_back({wakeFds_[0], POLLIN, 0});
+        } else {
+            deadline = std::min(deadline, now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(FALLBACK_WAIT));
+        }
+        {
+            std::lock_guard<std::recursive_mutex> lock(contextsMutex_);
+            for (libusb_context *context : contexts_) {
+                WatchedContext entry = {context, fds.size(), 0, std::chrono::steady_clock::time_point::max()};
+                const libusb_pollfd **list = libusb_get_pollfds(context);
+                if (list != nullptr) {
+                    for (size_t i = 0; list[i] != nullptr; ++i) {
+                        fds.push_back({list[i]->fd, list[i]->events, 0});
+                    }
+#if LIBUSB_API_VERSION >= 0x01000104
+                    libusb_free_pollfds(list);
+#else
+                    std::free(list);
+#endif
+                }
+                entry.count = fds.size() - entry.first;
+                timeval tv;
+                if (libusb_get_next_timeout(context, &tv) == 1) {  // libusb has to handle a transfer timeout by itself (only on platforms without timerfd support)
+                    entry.timeout = now + std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec);
+                    deadline = std::min(deadline, entry.timeout);
+                }
+                watched.push_back(entry);
+            }
+        }
+        timespec ts, *timeout = nullptr;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            std::chrono::nanoseconds wait = std::max(std::chrono::steady_clock::duration::zero(), deadline - now);
+            ts.tv_sec = static_cast<time_t>(std::chrono::duration_cast<std::chrono::seconds>(wait).count());
+            ts.tv_nsec = static_cast<long>((wait % std::chrono::seconds(1)).count());
+            timeout = &ts;
+        }
+        if (ppoll(fds.data(), fds.size(), timeout, nullptr) < 0 && errno != EINTR) {  // Should not happen, but if it does, avoid spinning
+            std::this_thread::sleep_for(FALLBACK_WAIT);
+        }
+        if (wakeFds_[0] >= 0 && (fds[0].revents & POLLIN) != 0) {
+            char buffer[64];
+            while (read(wakeFds_[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        now = std::chrono::steady_clock::now();
+        std::lock_guard<std::recursive_mutex> lock(contextsMutex_);
+        for (const WatchedContext &entry : watched) {
+            bool ready = entry.timeout <= now;
+            for (size_t i = entry.first; !ready && i < entry.first + entry.count; ++i) {
+                ready = fds[i].revents != 0;
+            }
+            if (ready && contexts_.count(entry.context) != 0) {  // The context may have been unwatched by a callback in the meantime, and then freed
+                timeval zero = {0, 0};
+                libusb_handle_events_timeout_completed(entry.context, &zero, nullptr);
+            }
+        }
+    }
+    threadId_.store(std::thread::id());
+    running_.store(false, std::memory_order_release);
+}
+
+// Runs the tasks posted so far (private)
+void EventLoop::runPosted()
+{
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(postedMutex_);
+        tasks.swap(posted_);
+    }
+    for (const Task &task : tasks) {
+        task();
+    }
+}
+
+// Runs the timers that are due (private)
+void EventLoop::runTimers()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.begin()->first <= now && !stop_.load(std::memory_order_acquire)) {
+        Task task = timers_.begin()->second;
+        timers_.erase(timers_.begin());  // Erased before running, since the task may add timers of its own
+        task();
+    }
+}
+
+// Interrupts the wait of the loop thread (private)
+void EventLoop::wake()
+{
+    if (wakeFds_[1] >= 0) {
+        ssize_t written = write(wakeFds_[1], "", 1);  // If the pipe is full, the loop is bound to wake up anyway
+        static_cast<void>(written);
+    }
+}
+
+// "EventLoop" class constructor
+EventLoop::EventLoop() :
+    timers_(),
+    posted_(),
+    postedMutex_(),
+    contexts_(),
+    contextsMutex_(),
+    wakeFds_{-1, -1},
+    running_(false),
+    stop_(false),
+    threadId_(std::thread::id())
+{
+    if (pipe2(wakeFds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        wakeFds_[0] = -1;
+        wakeFds_[1] = -1;
+    }
+}
+
+// "EventLoop" class destructor
+EventLoop::~EventLoop()
+{
+    stop();
+    if (wakeFds_[0] >= 0) {
+        ::close(wakeFds_[0]);
+        ::close(wakeFds_[1]);
+    }
+}
+
+// Returns true if called from the loop thread (e.g., from a callback)
+bool EventLoop::inLoopThread() const
+{
+    return threadId_.load() == std::this_thread::get_id();
+}
+
+// Returns true if the loop thread is running
+bool EventLoop::running() const
+{
+    return running_.load(std::memory_order_acquire);
+}
+
+// Runs the given task on the loop thread, once the given deadline is reached
+// The task runs as soon as possible after the deadline, but never before, and may run late if the loop thread is busy
+void EventLoop::at(const std::chrono::steady_clock::time_point &deadline, const Task &task)
+{
+    if (inLoopThread()) {
+        timers_.insert(std::make_pair(deadline, task));
+    } else {
+        post(std::bind(&EventLoop::at, this, deadline, task));  // The timers are only touched by the loop thread
+    }
+}
+
+// Runs the given task on the loop thread, as soon as possible
+// Tasks posted while the loop is stopped are kept, and run once it is started
+void EventLoop::post(const Task &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(postedMutex_);
+        posted_.push_back(task);
+    }
+    wake();
+}
+
+// Starts the loop thread
+void EventLoop::start()
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        stop_.store(false, std::memory_order_relaxed);
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&EventLoop::run, this);
+    }
+}
+
+// Stops the loop thread, without waiting for pending transfers or timers, which are resumed if the loop is started again
+// Important: this function must not be called from the loop thread itself!
+void EventLoop::stop()
+{
+    stop_.store(true, std::memory_order_release);
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// Stops handling the events of the given libusb context
+// Once this function returns, the loop no longer touches the context, which can then be freed (e.g., by closing the device)
+void EventLoop::unwatch(libusb_context *context)
+{
+    std::lock_guard<std::recursive_mutex> lock(contextsMutex_);
+    contexts_.erase(context);
+}
+
+// Starts handling the events of the given libusb context, which is needed for the completion of any asynchronous transfers submitted to the corresponding device
+void EventLoop::watch(libusb_context *context)
+{
+    if (context != nullptr) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(contextsMutex_);
+            contexts_.insert(context);
+        }
+        wake();  // The loop has to include the new context in its wait
+    }
+}
@@ -0,0 +1,71 @@
+/* ITUSB2 event loop class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <libusb-1.0/libusb.h>
+
+class EventLoop
+{
+public:
+    typedef std::function<void()> Task;
+
+private:
+    std::multimap<std::chrono::steady_clock::time_point, Task> timers_;  // Only accessed by the loop thread
+    std::vector<Task> posted_;
+    std::mutex postedMutex_;
+    std::set<libusb_context *> contexts_;
+    std::recursive_mutex contextsMutex_;                                // Recursive, since callbacks run while the loop holds it, and may watch or unwatch contexts
+    int wakeFds_[2];                                                    // Pipe used to interrupt the wait, when a task is posted from another thread
+    std::atomic<bool> running_, stop_;
+    std::atomic<std::thread::id> threadId_;
+    std::thread thread_;
+
+    void run();
+    void runPosted();
+    void runTimers();
+    void wake();
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    bool inLoopThread() const;
+    bool running() const;
+
+    void at(const std::chrono::steady_clock::time_point &deadline, const Task &task);
+    void post(const Task &task);
+    void start();
+    void stop();
+    void unwatch(libusb_context *context);
+    void watch(libusb_context *context);
+};
+
+#endif  // EVENTLOOP_H
@@ -0,0 +1,232 @@
+/* ITUSB2 Cycle Command - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "output.h"
+#include "realtime.h"
+#include "statistics.h"
+
+// Definitions
+static const size_t HIST_BAR = 50;  // Width of the longest histogram bar, in characters
+
+// Global variables
+static volatile sig_atomic_t interrupted = 0;  // Set when SIGINT or SIGTERM is received
+
+// Function prototypes
+void handleSignal(int signum);
+bool parseNumber(const char *str, unsigned long &value);
+void printHistogram(const Statistics &stats, size_t bins);
+void printStatistics(const std::string &name, const Statistics &stats);
+Record statisticsRecord(const std::string &prefix, const Statistics &stats);
+
+int main(int argc, char **argv)
+{
+    unsigned long cycles = 0, duration = 0, period = 0, bins = 10;  // Zero cycles and zero duration means that the test runs until interrupted
+    std::string filename;
+    int format = Output::TEXT;
+    bool valid = true;
+    static const option longOptions[] = {
+        {"bins", required_argument, nullptr, 'b'},
+        {"cycles", required_argument, nullptr, 'n'},
+        {"duration", required_argument, nullptr, 't'},
+        {"format", required_argument, nullptr, 'f'},
+        {"output", required_argument, nullptr, 'o'},
+        {"period", required_argument, nullptr, 'p'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "b:f:n:o:p:t:", longOptions, nullptr)) != -1) {
+        if (opt == 'b') {
+            valid = parseNumber(optarg, bins) && bins > 0;
+        } else if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else if (opt == 'n') {
+            valid = parseNumber(optarg, cycles);
+        } else if (opt == 'o') {
+            filename = optarg;
+        } else if (opt == 'p') {
+            valid = parseNumber(optarg, period);
+        } else if (opt == 't') {
+            valid = parseNumber(optarg, duration);
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || argc - optind > 1) {
+        printUsageError(format, "Usage: itusb2-cycle [-n CYCLES] [-t SECONDS] [-p MILLISECONDS] [-o FILE] [-b BINS] [-f text|csv|json] [SERIALNUMBER]\n");
+        return EXIT_USERERR;
+    }
+    Output output(format, std::cout, std::cerr);
+    std::ofstream file;
+    Output fileOutput(Output::CSV, file, std::cerr);  // The output file is always in CSV format
+    if (!filename.empty()) {
+        file.open(filename);
+        if (!file.is_open()) {
+            output.error(ERRCODE_FILE, "Could not open \"" + filename + "\" for writing.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    int errlvl = EXIT_SUCCESS;
+    ITUSB2Device device;
+    int err = openDevice(device, optind < argc ? argv[optind] : std::string());  // Open the device having the specified serial number (or the first device found, if none was specified), taking it over from the daemon if necessary
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        signal(SIGINT, handleSignal);  // The test can be stopped at any time, and the results obtained so far are still reported
+        signal(SIGTERM, handleSignal);
+        int errcnt = 0;
+        std::string errstr;
+        Statistics cdStats, hsStats;
+        unsigned long counter = 0, failures = 0, fullSpeed = 0, bounces = 0, bouncyCycles = 0, overflows = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), next = start;
+        while (!interrupted && (cycles == 0 || counter < cycles) && (duration == 0 || std::chrono::steady_clock::now() - start < std::chrono::seconds(duration))) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            while (!interrupted && now < next) {  // Keep the configured rate, by waiting until the next cycle is due (the sleep is split, so that the program responds promptly to interruptions)
+                sleepUntil(std::min(next, now + std::chrono::milliseconds(100)));
+                now = std::chrono::steady_clock::now();
+            }
+            if (interrupted) {
+                break;
+            }
+            next = now + std::chrono::milliseconds(period);
+            ITUSB2Device::EnumTiming timing = device.enumerate(errcnt, errstr);  // Detach and reattach DUT, measuring how long it takes to connect and to link at high speed
+            ++counter;  // A cycle that fails partway due to a device error is still accounted for, with whatever was measured until then
+            if (timing.cdOverflow) {
+                ++overflows;
+            } else if (timing.cdEdges > 1) {  // Every UDCD rising edge after the first one is a bounce
+                bounces += timing.cdEdges - 1;
+                ++bouncyCycles;
+            }
+            if (!timing.cd) {
+                ++failures;
+            } else {
+                cdStats.add(timing.cdLatency / 1000.0);
+                if (timing.hs) {
+                    hsStats.add(timing.hsLatency / 1000.0);
+                } else if (errcnt == 0) {  // The link speed of a cycle that failed partway is unknown
+                    ++fullSpeed;
+                }
+            }
+            Record record = Record().integer("cycle", counter).integer("time_ms", std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count()).boolean("connected", timing.cd).boolean("high_speed", timing.hs).integer("connect_us", timing.cdLatency).integer("high_speed_us", timing.hsLatency).integer("connect_edges", timing.cdEdges).boolean("counter_overflow", timing.cdOverflow).boolean("device_error", errcnt > 0);
+            if (file.is_open()) {  // Stream each record as soon as it is available, so that no results are lost if the test is aborted
+                fileOutput.record(record);
+            }
+            if (format != Output::TEXT) {  // In machine-readable formats, the records are also streamed to the standard output
+                output.record(record);
+            }
+            if (errcnt > 0) {  // Stop at the first device error, since the remaining cycles would not be meaningful
+                break;
+            }
+        }
+        if (format != Output::TEXT) {  // The summary is given as a final record, which has different fields
+            output.record(Record().integer("cycles", counter).integer("detected", counter - failures).integer("high_speed_count", hsStats.count()).integer("full_speed_count", fullSpeed).integer("bounces", bounces).integer("bouncy_cycles", bouncyCycles).integer("counter_overflows", overflows).boolean("device_error", errcnt > 0).append(statisticsRecord("connect", cdStats)).append(statisticsRecord("high_speed", hsStats)));
+        } else {
+            std::cout << "Cycles: " << counter << " (" << counter - failures << " detected, " << failures << " not detected)";
+            if (errcnt > 0) {
+                std::cout << ", the last one failed due to a device error";
+            }
+            std::cout << "\n";
+            std::cout << "Link speed: " << hsStats.count() << " high speed, " << fullSpeed << " full/low speed\n";
+            std::cout << "Connection bounces: " << bounces << " in " << bouncyCycles << " cycles";
+            if (overflows > 0) {
+                std::cout << " (the counter overflowed in " << overflows << " cycles)";
+            }
+            std::cout << "\n";
+            printStatistics("Time to connect", cdStats);
+            printStatistics("Time to high speed", hsStats);
+            if (cdStats.count() > 0) {
+                std::cout << "Histogram of time to connect:\n";
+                printHistogram(cdStats, bins);
+            }
+            std::cout.flush();
+        }
+        reportRealtime(device);
+        reportRecovery(device);
+        if (errcnt > 0) {  // In case of error
+            reportDeviceErrors(device, errstr, output);
+            errlvl = EXIT_FAILURE;
+        }
+        device.close();
+    } else {  // Failed to open device
+        printOpenError(err, output);
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
+
+// Signal handler that requests the test to stop after the current cycle
+void handleSignal(int signum)
+{
+    (void)signum;
+    interrupted = 1;
+}
+
+// Parses a non-negative decimal number, returning false if the given string is not valid
+bool parseNumber(const char *str, unsigned long &value)
+{
+    char *end;
+    value = std::strtoul(str, &end, 10);
+    return *str >= '0' && *str <= '9' && *end == '\0';
+}
+
+// Prints a histogram of the given statistics, using the given number of bins
+void printHistogram(const Statistics &stats, size_t bins)
+{
+    double width;
+    std::vector<size_t> counts = stats.histogram(bins, width);
+    size_t highest = 0;
+    for (size_t count : counts) {
+        highest = count > highest ? count : highest;
+    }
+    std::cout << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        std::cout << std::setw(10) << stats.min() + i * width << " - " << std::setw(10) << stats.min() + (i + 1) * width << "ms | "
+                  << std::string(highest > 0 ? counts[i] * HIST_BAR / highest : 0, '#') << " " << counts[i] << "\n";
+    }
+}
+
+// Prints the latency distribution of the given statistics, in milliseconds
+void printStatistics(const std::string &name, const Statistics &stats)
+{
+    std::cout << name << ": ";
+    if (stats.count() == 0) {
+        std::cout << "N/A\n";
+    } else {
+        std::cout << std::fixed << std::setprecision(3)
+                  << "p50 " << stats.percentile(50) << "ms, p95 " << stats.percentile(95) << "ms, p99 " << stats.percentile(99) << "ms, max " << stats.max() << "ms\n";
+    }
+}
+
+// Returns a record containing the latency distribution of the given statistics, in milliseconds, using the given prefix for the field names (all values are zero if there are no samples)
+Record statisticsRecord(const std::string &prefix, const Statistics &stats)
+{
+    bool empty = stats.count() == 0;
+    return Record().number(prefix + "_p50_ms", empty ? 0 : stats.percentile(50), 3).number(prefix + "_p95_ms", empty ? 0 : stats.percentile(95), 3).number(prefix + "_p99_ms", empty ? 0 : stats.percentile(99), 3).number(prefix + "_max_ms", empty ? 0 : stats.max(), 3);
+}
@@ -1,4 +1,4 @@
-/* ITUSB2 Detach Command - Version 2.1 for Debian Linux
+/* ITUSB2 Detach Command - Version 2.2 for Debian Linux
    Copyright (c) 2020-2022 Samuel Lourenço
 
    This program is free software: you can redistribute it and/or modify it
@@ -19,45 +19,9 @@
 
 
 // Includes
-#include <cstdlib>
-#include <iostream>
-#include <string>
-#include "error.h"
-#include "itusb2device.h"
+#include "commands.h"
 
 int main(int argc, char **argv)
 {
-    int err, errlvl = EXIT_SUCCESS;
-    ITUSB2Device device;
-    if (argc < 2) {  // If the program was called without arguments
-        err = device.open();  // Open a device and get the device handle
-    } else {  // Serial number was specified as argument
-        err = device.open(argv[1]);  // Open the device having the specified serial number, and get the device handle
-    }
-    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
-        int errcnt = 0;
-        std::string errstr;
-        device.detach(errcnt, errstr);  // Detach DUT from HUT
-        if (errcnt > 0) {  // In case of error
-            if (device.disconnected()) {  // If the device disconnected
-                std::cerr << "Error: Device disconnected.\n";
-            } else {
-                printErrors(errstr);
-            }
-            errlvl = EXIT_FAILURE;
-        } else {  // Operation successful
-            std::cout << "USB device detached." << std::endl;
-        }
-        device.close();
-    } else {  // Failed to open device
-        if (err == ITUSB2Device::ERROR_INIT) {  // Failed to initialize libusb
-            std::cerr << "Error: Could not initialize libusb\n";
-        } else if (err == ITUSB2Device::ERROR_NOT_FOUND) {  // Failed to find device
-            std::cerr << "Error: Could not find device.\n";
-        } else if (err == ITUSB2Device::ERROR_BUSY) {  // Failed to claim interface
-            std::cerr << "Error: Device is currently unavailable.\n";
-        }
-        errlvl = EXIT_FAILURE;
-    }
-    return errlvl;
+    return commandMain("detach", argc, argv);  // Detach DUT from HUT (the command is forwarded to the daemon, if running)
 }
@@ -0,0 +1,120 @@
+/* ITUSB2 Group Command - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "output.h"
+
+int main(int argc, char **argv)
+{
+    int format = Output::TEXT;
+    uint16_t lines = ITUSB2Device::LINES_POWER | ITUSB2Device::LINES_DATA;
+    std::string linesName = "power and data lines";
+    bool valid = true;
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"lines", required_argument, nullptr, 'l'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:l:", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else if (opt == 'l') {
+            std::string value = optarg;
+            if (value == "power") {
+                lines = ITUSB2Device::LINES_POWER;
+                linesName = "power";
+            } else if (value == "data") {
+                lines = ITUSB2Device::LINES_DATA;
+                linesName = "data lines";
+            } else {
+                valid = value == "both";
+            }
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    std::string state = optind < argc ? argv[optind] : "";
+    if (!valid || (state != "on" && state != "off")) {
+        printUsageError(format, "Usage: itusb2-group [-f text|csv|json] [-l power|data|both] on|off [SERIALNUMBER...]\n");
+        return EXIT_USERERR;
+    }
+    int errcnt = 0, errlvl = EXIT_SUCCESS;
+    std::string errstr;
+    Output output(format, std::cout, std::cerr);
+    std::vector<std::string> serials(argv + optind + 1, argv + argc);
+    if (serials.empty()) {  // If no serial numbers are specified, all connected devices are switched
+        std::list<std::string> deviceList = ITUSB2Device::listDevices(errcnt, errstr);
+        serials.assign(deviceList.begin(), deviceList.end());
+    }
+    if (errcnt > 0) {
+        output.error(ERRCODE_DEVICE, errstr);
+        errlvl = EXIT_FAILURE;
+    } else if (serials.empty()) {
+        output.error(ERRCODE_NOT_FOUND, "Could not find any device.\n");
+        errlvl = EXIT_FAILURE;
+    } else {
+        std::vector<ITUSB2Device> devices(serials.size());
+        std::vector<ITUSB2Device *> group;
+        for (size_t i = 0; i < serials.size() && errlvl == EXIT_SUCCESS; ++i) {  // All devices are opened beforehand, so that the group is switched either as a whole or not at all
+            int err = openDevice(devices[i], serials[i]);  // Take the device over from the daemon, if necessary
+            if (err == ITUSB2Device::SUCCESS) {
+                group.push_back(&devices[i]);
+            } else {
+                printOpenError(err, output);
+                errlvl = EXIT_FAILURE;
+            }
+        }
+        if (errlvl == EXIT_SUCCESS) {
+            ITUSB2Device::GroupTiming timing = ITUSB2Device::switchGroup(group, lines, state == "on", errcnt, errstr);
+            if (errcnt > 0) {
+                bool disconnected = false;
+                for (ITUSB2Device *device : group) {
+                    disconnected = disconnected || device->disconnected();
+                }
+                if (disconnected) {
+                    output.error(ERRCODE_DISCONNECTED, "Device disconnected.\n");
+                } else {
+                    output.error(ERRCODE_DEVICE, errstr);
+                }
+                errlvl = EXIT_FAILURE;
+            } else if (format != Output::TEXT) {
+                output.record(Record().integer("devices", static_cast<long long>(group.size())).boolean("power", (lines & ITUSB2Device::LINES_POWER) != 0).boolean("data", (lines & ITUSB2Device::LINES_DATA) != 0).boolean("state", state == "on").integer("submission_skew_us", timing.submissionSkew).integer("completion_skew_us", timing.completionSkew).integer("duration_us", timing.duration));
+            } else {
+                std::cout << "Switched " << linesName << " of " << group.size() << " device" << (group.size() == 1 ? "" : "s") << " " << state << ".\n";
+                std::cout << std::fixed << std::setprecision(3);
+                std::cout << "Completion skew: " << timing.completionSkew / 1000.0 << "ms (submission skew " << timing.submissionSkew / 1000.0 << "ms, total " << timing.duration / 1000.0 << "ms)\n";
+            }
+        }
+        for (ITUSB2Device *device : group) {
+            device->close();
+        }
+    }
+    return errlvl;
+}
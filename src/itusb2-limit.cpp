@@ -0,0 +1,164 @@
+/* ITUSB2 Limit Command - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "commands.h"
+#include "itusb2device.h"
+#include "output.h"
+
+// Global variables
+static std::atomic<bool> interrupted(false);  // Set when SIGINT or SIGTERM is received
+
+// Function prototypes
+void handleSignal(int signum);
+bool parseNumber(const char *str, float &value);
+bool parseNumber(const char *str, unsigned long &value);
+
+int main(int argc, char **argv)
+{
+    ITUSB2Device::CurrentLimit limit = {0, 0, 0, false};
+    float reaction = 10;  // Required reaction time, in milliseconds
+    unsigned long retry = 0, trips = 0;  // By default, there are no retries, and monitoring stops at the first trip
+    int format = Output::TEXT;
+    bool valid = true;
+    static const option longOptions[] = {
+        {"budget", required_argument, nullptr, 'b'},
+        {"data", no_argument, nullptr, 'd'},
+        {"format", required_argument, nullptr, 'f'},
+        {"limit", required_argument, nullptr, 'l'},
+        {"rating", required_argument, nullptr, 'r'},
+        {"reaction", required_argument, nullptr, 't'},
+        {"retry", required_argument, nullptr, 'a'},
+        {"trips", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "a:b:df:l:n:r:t:", longOptions, nullptr)) != -1) {
+        if (opt == 'a') {
+            valid = parseNumber(optarg, retry);
+        } else if (opt == 'b') {
+            valid = parseNumber(optarg, limit.budget);
+        } else if (opt == 'd') {
+            limit.data = true;
+        } else if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else if (opt == 'l') {
+            valid = parseNumber(optarg, limit.threshold);
+        } else if (opt == 'n') {
+            valid = parseNumber(optarg, trips);
+        } else if (opt == 'r') {
+            valid = parseNumber(optarg, limit.rating);
+        } else if (opt == 't') {
+            valid = parseNumber(optarg, reaction) && reaction > 0;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || (limit.threshold == 0 && limit.budget == 0) || argc - optind > 1) {  // At least one of the limits must be set
+        printUsageError(format, "Usage: itusb2-limit [-l MILLIAMPS] [-r MILLIAMPS -b BUDGET] [-t MILLISECONDS] [-d] [-a MILLISECONDS [-n TRIPS]] [-f text|csv|json] [SERIALNUMBER]\n");
+        return EXIT_USERERR;
+    }
+    int errlvl = EXIT_SUCCESS;
+    Output output(format, std::cout, std::cerr);
+    ITUSB2Device device;
+    int err = openDevice(device, optind < argc ? argv[optind] : std::string());  // Open the device having the specified serial number (or the first device found, if none was specified), taking it over from the daemon if necessary
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+        int errcnt = 0;
+        std::string errstr;
+        device.setup(errcnt, errstr);  // Prepare the device (SPI setup)
+        unsigned long counter = 0;
+        std::cout << std::fixed << std::setprecision(3);
+        while (errcnt == 0 && !interrupted) {
+            ITUSB2Device::CurrentTrip trip = device.limitCurrent(limit, interrupted, errcnt, errstr);  // Blocks until a trip occurs, or until interrupted
+            if (!trip.tripped) {
+                break;
+            }
+            ++counter;
+            float worst = (trip.maxPeriod + trip.switching) / 1000.0f;  // Worst-case reaction time, assuming that the condition began right after the previous sample
+            if (format != Output::TEXT) {  // One record per trip
+                output.record(Record().integer("trip", counter).string("cause", trip.i2t ? "i2t" : "limit").number("current_ma", trip.current, 1).number("time_s", trip.time / 1000000.0, 3).integer("samples", trip.samples).integer("detection_us", trip.detection).integer("switching_us", trip.switching).integer("worst_case_us", trip.maxPeriod + trip.switching).boolean("reaction_exceeded", worst > reaction));
+            } else {
+                std::cout << "Trip " << counter << ": " << std::setprecision(1) << trip.current << "mA exceeded the " << (trip.i2t ? "I2t budget" : "current limit")
+                          << std::setprecision(3) << " at " << trip.time / 1000000.0 << "s, switched off in " << (trip.detection + trip.switching) / 1000.0
+                          << "ms (detection " << trip.detection / 1000.0 << "ms, switching " << trip.switching / 1000.0 << "ms, worst case " << worst << "ms)\n";
+                if (worst > reaction) {
+                    std::cout << "Warning: Worst-case reaction time exceeds the required " << reaction << "ms!\n";
+                }
+                std::cout.flush();
+            }
+            if (retry == 0 || (trips != 0 && counter >= trips)) {
+                break;
+            }
+            usleep(static_cast<useconds_t>(1000 * retry));  // Wait before restoring power
+            if (!interrupted) {
+                if (limit.data) {
+                    device.switchUSB(true, errcnt, errstr);  // Switch VBUS on and connect the data lines
+                } else {
+                    device.switchUSBPower(true, errcnt, errstr);  // Switch VBUS on
+                }
+            }
+        }
+        reportRecovery(device);
+        if (errcnt > 0) {  // In case of error
+            reportDeviceErrors(device, errstr, output);
+            errlvl = EXIT_FAILURE;
+        } else if (counter == 0 && format == Output::TEXT) {  // In machine-readable formats, the absence of trip records means that no trips occurred
+            std::cout << "No trips occurred.\n";
+        }
+        device.close();
+    } else {  // Failed to open device
+        printOpenError(err, output);
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
+
+// Signal handler that requests monitoring to stop
+void handleSignal(int signum)
+{
+    (void)signum;
+    interrupted = true;
+}
+
+// Parses a non-negative decimal number, returning false if the given string is not valid
+bool parseNumber(const char *str, float &value)
+{
+    char *end;
+    value = std::strtof(str, &end);
+    return ((*str >= '0' && *str <= '9') || *str == '.') && *end == '\0';
+}
+
+// Parses a non-negative integer, returning false if the given string is not valid
+bool parseNumber(const char *str, unsigned long &value)
+{
+    char *end;
+    value = std::strtoul(str, &end, 10);
+    return *str >= '0' && *str <= '9' && *end == '\0';
+}
@@ -1,4 +1,4 @@
-/* ITUSB2 List Command - Version 2.0 for Debian Linux
+/* ITUSB2 List Command - Version 2.1 for Debian Linux
    Copyright (c) 2020-2022 Samuel Lourenço
 
    This program is free software: you can redistribute it and/or modify it
@@ -19,23 +19,71 @@
 
 
 // Includes
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
 #include <iostream>
 #include <list>
+#include <sstream>
 #include <string>
-#include "error.h"
+#include <vector>
+#include "commands.h"
 #include "itusb2device.h"
+#include "output.h"
 
-int main()
+// Function prototypes
+int listDetails(Output &output, unsigned long timeout);
+
+int main(int argc, char **argv)
 {
+    int format = Output::TEXT;
+    bool verbose = false, verboseOpts = false, valid = true;
+    unsigned long timeout = 2000;  // Time limit for each device query, in milliseconds
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"timeout", required_argument, nullptr, 't'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:t:v", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else if (opt == 't') {
+            char *end;
+            timeout = std::strtoul(optarg, &end, 10);
+            valid = *optarg >= '0' && *optarg <= '9' && *end == '\0' && timeout > 0;
+            verboseOpts = true;
+        } else if (opt == 'v') {
+            verbose = true;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || optind < argc || (verboseOpts && !verbose)) {  // The timeout only applies to the verbose mode
+        printUsageError(format, "Usage: itusb2-list [-f text|csv|json] [-v [-t MILLISECONDS]]\n");
+        return EXIT_USERERR;
+    }
+    Output output(format, std::cout, std::cerr);
+    if (verbose) {
+        return listDetails(output, timeout);
+    }
     int errcnt = 0, errlvl = EXIT_SUCCESS;
     std::string errstr;
     std::list<std::string> deviceList = ITUSB2Device::listDevices(errcnt, errstr);  // Get a device list
     if (errcnt > 0) {  // In case of error
-        printErrors(errstr);
+        output.error(ERRCODE_DEVICE, errstr);
         errlvl = EXIT_FAILURE;
+    } else if (format != Output::TEXT) {  // One record per device (no records are printed if the list is empty)
+        size_t counter = 0;  // Device counter
+        for (std::string device : deviceList) {  // Traverse device list
+            ++counter;
+            output.record(Record().integer("index", counter).string("serial", device).boolean("default", counter == 1));
+        }
     } else if (deviceList.empty()) {  // If list is empty
-        std::cout << "No devices found." << std::endl;
+        std::cout << "No devices found.\n";
     } else {
         size_t counter = 0;  // Device counter
         for (std::string device : deviceList) {  // Traverse device list
@@ -44,7 +92,56 @@ int main()
             if (counter == 1) {  // The first device on the list is always the preferred one
                 std::cout << " (default)";
             }
-            std::cout << std::endl;
+            std::cout << "\n";
+        }
+    }
+    std::cout.flush();
+    return errlvl;
+}
+
+// Lists all devices along with their details, which are gathered concurrently - Returns the exit status
+int listDetails(Output &output, unsigned long timeout)
+{
+    int errcnt = 0, errlvl = EXIT_SUCCESS;
+    std::string errstr;
+    std::vector<ITUSB2Device::DeviceDetails> devices = ITUSB2Device::listDeviceDetails(std::chrono::milliseconds(timeout), errcnt, errstr);
+    if (errcnt > 0) {  // In case of error
+        output.error(ERRCODE_DEVICE, errstr);
+        errlvl = EXIT_FAILURE;
+    } else if (output.format() != Output::TEXT) {  // One record per device, always with the same fields
+        for (size_t i = 0; i < devices.size(); ++i) {
+            const ITUSB2Device::DeviceDetails &device = devices[i];
+            std::ostringstream silicon;
+            if (device.valid) {
+                silicon << static_cast<int>(device.siliconVersion.maj) << "." << static_cast<int>(device.siliconVersion.min);
+            }
+            output.record(Record().integer("index", i + 1).string("serial", device.location.serial).boolean("default", i == 0).integer("bus", device.location.bus).integer("address", device.location.address).string("port", device.location.port).boolean("busy", device.busy).boolean("valid", device.valid).string("error", device.error).string("hardware_revision", device.hardwareRevision).string("silicon_version", silicon.str()).integer("max_power_ma", device.maxPower));
+        }
+    } else if (devices.empty()) {
+        std::cout << "No devices found.\n";
+    } else {
+        size_t width = 13;  // Width of the serial number column, which is at least the width of its heading
+        for (const ITUSB2Device::DeviceDetails &device : devices) {
+            width = std::max(width, device.location.serial.size());
+        }
+        std::cout << std::left << "#  " << std::setw(width) << "Serial number" << "  Port        Revision  Silicon  Max power\n";
+        for (size_t i = 0; i < devices.size(); ++i) {
+            const ITUSB2Device::DeviceDetails &device = devices[i];
+            std::cout << std::left << std::setw(3) << i + 1 << std::setw(width) << device.location.serial << "  " << std::setw(10) << device.location.port << "  ";
+            if (device.valid) {
+                std::ostringstream silicon;
+                silicon << static_cast<int>(device.siliconVersion.maj) << "." << static_cast<int>(device.siliconVersion.min);
+                std::cout << std::setw(8) << device.hardwareRevision << "  " << std::setw(7) << silicon.str() << "  " << device.maxPower << "mA";
+            } else {
+                std::cout << (device.busy ? "In use" : "Error: " + device.error);
+            }
+            std::cout << (i == 0 ? " (default)" : "") << "\n";
+        }
+    }
+    std::cout.flush();
+    for (const ITUSB2Device::DeviceDetails &device : devices) {
+        if (!device.valid && !device.busy) {  // The exit status reflects any device that could not be queried, except for devices in use, which are expected
+            errlvl = EXIT_FAILURE;
         }
     }
     return errlvl;
@@ -1,4 +1,4 @@
-/* ITUSB2 LockOTP Command - Version 2.1 for Debian Linux
+/* ITUSB2 LockOTP Command - Version 2.3 for Debian Linux
    Copyright (c) 2020-2022 Samuel Lourenço
 
    This program is free software: you can redistribute it and/or modify it
@@ -19,15 +19,18 @@
 
 
 // Includes
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <string>
 #include "cp2130.h"
 #include "error.h"
 #include "itusb2device.h"
+#include "protocol.h"
 
 // Definitions
 static const int EXIT_USERERR = 2;  // Exit status value to indicate a command usage error
+static const std::chrono::milliseconds RESET_TIMEOUT(5000);  // Time limit for the device to come back after reset, so that the lock can be verified (added in version 2.3)
 
 int main(int argc, char **argv)
 {
@@ -38,6 +41,9 @@ int main(int argc, char **argv)
     } else {
         CP2130 cp2130;
         int err = cp2130.open(ITUSB2Device::VID, ITUSB2Device::PID, argv[1]);
+        if (err == ITUSB2Device::ERROR_BUSY && releaseDevice(argv[1])) {  // If the device is in use by the daemon, ask it to release the device, and try again
+            err = cp2130.open(ITUSB2Device::VID, ITUSB2Device::PID, argv[1]);
+        }
         if (err == ITUSB2Device::SUCCESS) {  // Open the device having the specified serial number, and get the device handle. If successful
             int errcnt = 0;
             std::string errstr;
@@ -50,16 +56,25 @@ int main(int argc, char **argv)
                 std::cin.get(cin);  // Get character entered by user
                 if (cin == 'Y' || cin == 'y') {  // If user entered "Y" or "y"
                     cp2130.lockOTP(errcnt, errstr);  // Lock the OTP ROM
-                    cp2130.reset(errcnt, errstr);  // Reset the device
+                    CP2130::ResetTiming timing = {0, 0};
+                    if (errcnt == 0) {
+                        timing = cp2130.resetAndReopen(RESET_TIMEOUT, errcnt, errstr);  // Reset the device, and reopen it once it re-enumerates, so that the updated register values can be read (since version 2.3)
+                    }
+                    bool locked = errcnt == 0 && cp2130.isOTPLocked(errcnt, errstr);
                     if (errcnt > 0) {  // In case of error
-                        if (cp2130.disconnected()) {  // If the device disconnected
+                        if (timing.departure != 0 && timing.ready == 0) {  // The device was reset, but did not come back in time
+                            std::cerr << "Error: Device did not come back after reset, so the lock could not be verified.\n";
+                        } else if (cp2130.disconnected()) {  // If the device disconnected
                             std::cerr << "Error: Device disconnected.\n";
                         } else {
                             printErrors(errstr);
                         }
                         errlvl = EXIT_FAILURE;
+                    } else if (!locked) {  // The lock word was read back after reset, and some fields are still unlocked
+                        std::cerr << "Error: Device OTP ROM could not be locked.\n";
+                        errlvl = EXIT_FAILURE;
                     } else {  // Operation successful
-                        std::cout << "Device OTP ROM is now locked." << std::endl;  // Notice that no verification is done after reset, since the device has to be allowed to re-enumerate before getting the updated register values
+                        std::cout << "Device OTP ROM is now locked (verified after reset, device ready in " << timing.ready / 1000 << "ms)." << std::endl;
                     }
                 } else {  // If user entered any other character
                     std::cout << "Lock operation canceled." << std::endl;
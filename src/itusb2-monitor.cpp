@@ -0,0 +1,186 @@
+/* ITUSB2 Monitor Command - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "monitor.h"
+#include "output.h"
+
+// Definitions
+const int READ_INTERVAL = 10;  // Interval between reads of the event log, in milliseconds (this only affects the latency of the output, not the resolution of the events)
+
+// Global variables
+static std::atomic<bool> interrupted(false);  // Set when SIGINT or SIGTERM is received
+
+// Function prototypes
+void handleSignal(int signum);
+bool parseNumber(const char *str, unsigned long &value);
+void printEvent(const GPIOMonitor::Event &event, Output &output);
+
+int main(int argc, char **argv)
+{
+    int format = Output::TEXT;
+    unsigned long interval = 1000;  // Polling interval, in microseconds (zero means busy polling)
+    unsigned long limit = 0;  // Time limit, in seconds (zero means no limit)
+    bool valid = true;
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"interval", required_argument, nullptr, 'i'},
+        {"time", required_argument, nullptr, 't'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:i:t:", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else if (opt == 'i') {
+            valid = parseNumber(optarg, interval);
+        } else if (opt == 't') {
+            valid = parseNumber(optarg, limit);
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || argc - optind > 1) {
+        printUsageError(format, "Usage: itusb2-monitor [-f text|csv|json] [-i MICROSECONDS] [-t SECONDS] [SERIALNUMBER]\n");
+        return EXIT_USERERR;
+    }
+    std::string serial = optind < argc ? argv[optind] : std::string();  // Specifying a serial number is optional
+    int errlvl = EXIT_SUCCESS;
+    Output output(format, std::cout, std::cerr);
+    ITUSB2Device device;
+    int err = openDevice(device, serial);  // Open the device, taking it over from the daemon if necessary
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+        GPIOMonitor monitor(device);
+        uint64_t cursor = 0, lost = 0;
+        std::vector<GPIOMonitor::Event> events;
+        monitor.start(std::chrono::microseconds(interval));
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool running = true;
+        while (running) {  // The log is read once more after the monitor stops, so that no events are left behind
+            running = !interrupted && monitor.running() && (limit == 0 || std::chrono::steady_clock::now() - start < std::chrono::seconds(limit));
+            if (!running) {
+                int errcnt = 0;
+                std::string errstr;
+                monitor.stop(errcnt, errstr);
+                if (errcnt > 0) {  // In case of error
+                    reportDeviceErrors(device, errstr, output);
+                    errlvl = EXIT_FAILURE;
+                }
+            }
+            events.clear();
+            lost += monitor.read(cursor, events);
+            for (const GPIOMonitor::Event &event : events) {
+                printEvent(event, output);
+            }
+            if (running) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(READ_INTERVAL));
+            }
+        }
+        if (format == Output::TEXT) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << monitor.polls() << " polls, " << monitor.events() << " events";
+            if (lost > 0) {
+                std::cout << " (" << lost << " lost)";
+            }
+            if (monitor.polls() > 0) {
+                std::cout << ", average poll period " << std::fixed << std::setprecision(1) << 1000000 * elapsed / monitor.polls() << "us";
+            }
+            std::cout << ".\n";
+        }
+        device.close();
+    } else {  // Failed to open device
+        printOpenError(err, output);
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
+
+// Signal handler that requests the monitor to stop
+void handleSignal(int signum)
+{
+    (void)signum;
+    interrupted = true;
+}
+
+// Parses a non-negative integer, returning false if the given string is not valid
+bool parseNumber(const char *str, unsigned long &value)
+{
+    char *end;
+    value = std::strtoul(str, &end, 10);
+    return *str >= '0' && *str <= '9' && *end == '\0';
+}
+
+// Prints the given event, either as a single line or as one record per signal that changed (all signals, for the initial state)
+void printEvent(const GPIOMonitor::Event &event, Output &output)
+{
+    static const struct {
+        uint16_t signal;
+        bool activeLow;
+        const char *name;
+        const char *on;
+        const char *off;
+        const char *initialOff;  // Used instead of "off" for the initial state, since nothing was lost or cleared
+    } signals[] = {
+        {ITUSB2Device::SIGNAL_UPEN, true, "power", "power on", "power off", "power off"},
+        {ITUSB2Device::SIGNAL_UDEN, true, "data", "data on", "data off", "data off"},
+        {ITUSB2Device::SIGNAL_UDOC, true, "fault", "fault detected", "fault cleared", "no fault"},
+        {ITUSB2Device::SIGNAL_UDCD, false, "connected", "device connected", "device disconnected", "no device"},
+        {ITUSB2Device::SIGNAL_UDHS, false, "high_speed", "high speed link", "high speed link lost", "no high speed link"}
+    };
+    uint16_t changed = event.changed == 0 ? ITUSB2Device::SIGNALS : event.changed;  // The initial state is reported as if every signal changed
+    double time = event.time / 1e9, resolution = event.resolution / 1e3;
+    if (output.format() != Output::TEXT) {
+        for (const auto &signal : signals) {
+            if ((changed & signal.signal) != 0) {
+                bool state = ((event.signals & signal.signal) != 0) != signal.activeLow;
+                output.record(Record().integer("sequence", event.sequence).number("time_s", time, 6).string("signal", signal.name).boolean("state", state).string("event", event.changed == 0 ? "initial" : (state ? signal.on : signal.off)).number("resolution_us", resolution, 1));
+            }
+        }
+    } else {
+        std::cout << std::fixed << std::setprecision(6) << time << "s: " << (event.changed == 0 ? "Initial state: " : "");
+        bool first = true;
+        for (const auto &signal : signals) {
+            if ((changed & signal.signal) != 0) {
+                bool state = ((event.signals & signal.signal) != 0) != signal.activeLow;
+                std::cout << (first ? "" : ", ") << (state ? signal.on : (event.changed == 0 ? signal.initialOff : signal.off));
+                first = false;
+            }
+        }
+        if (event.changed != 0) {
+            std::cout << " (within " << std::setprecision(1) << resolution << "us)";  // The transition occurred between the previous poll and this one
+        }
+        std::cout << "\n";
+        std::cout.flush();
+    }
+}
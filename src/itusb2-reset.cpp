@@ -1,4 +1,4 @@
-/* ITUSB2 Reset Command - Version 2.1 for Debian Linux
+/* ITUSB2 Reset Command - Version 2.3 for Debian Linux
    Copyright (c) 2020-2022 Samuel Lourenço
 
    This program is free software: you can redistribute it and/or modify it
@@ -19,44 +19,98 @@
 
 
 // Includes
+#include <chrono>
 #include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
 #include <iostream>
 #include <string>
-#include "error.h"
+#include "commands.h"
 #include "itusb2device.h"
+#include "output.h"
+
+// Function prototypes
+bool parseNumber(const char *str, unsigned long &value);
+int resetAndWait(const std::string &serial, Output &output, unsigned long timeout);
 
 int main(int argc, char **argv)
 {
-    int err, errlvl = EXIT_SUCCESS;
-    ITUSB2Device device;
-    if (argc < 2) {  // If the program was called without arguments
-        err = device.open();  // Open a device and get the device handle
-    } else {  // Serial number was specified as argument
-        err = device.open(argv[1]);  // Open the device having the specified serial number, and get the device handle
+    bool wait = false, waitOpts = false, valid = true;
+    unsigned long timeout = 5000;  // Time limit for the device to come back after reset, in milliseconds
+    std::string format = "text";
+    int fmt = Output::TEXT;
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {"timeout", required_argument, nullptr, 't'},
+        {"wait", no_argument, nullptr, 'w'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:t:w", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            format = optarg;
+            valid = Output::parseFormat(format, fmt);
+        } else if (opt == 't') {
+            valid = parseNumber(optarg, timeout) && timeout > 0;
+            waitOpts = true;
+        } else if (opt == 'w') {
+            wait = true;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || argc - optind > 1 || (waitOpts && !wait)) {  // The timeout only applies when waiting for the device
+        printUsageError(fmt, "Usage: itusb2-reset [-f text|csv|json] [-w [-t MILLISECONDS]] [SERIALNUMBER]\n");
+        return EXIT_USERERR;
     }
+    std::string serial = optind < argc ? argv[optind] : std::string();  // Specifying a serial number is optional
+    int errlvl;
+    if (wait) {
+        Output output(fmt, std::cout, std::cerr);
+        errlvl = resetAndWait(serial, output, timeout);
+    } else {
+        errlvl = runCommand(serial, {"reset", format});  // Reset the target device (the command is forwarded to the daemon, if running)
+    }
+    return errlvl;
+}
+
+// Parses a non-negative integer, returning false if the given string is not valid
+bool parseNumber(const char *str, unsigned long &value)
+{
+    char *end;
+    value = std::strtoul(str, &end, 10);
+    return *str >= '0' && *str <= '9' && *end == '\0';
+}
+
+// Resets the device having the given serial number (or the first device found, if the serial number is empty), waits for it to come back, and prints how long it took - Returns the exit status
+// The device is taken over from the daemon, if necessary, since the daemon would otherwise operate it while it is reopened
+int resetAndWait(const std::string &serial, Output &output, unsigned long timeout)
+{
+    int errlvl = EXIT_SUCCESS;
+    ITUSB2Device device;
+    int err = openDevice(device, serial);
     if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
         int errcnt = 0;
         std::string errstr;
-        device.reset(errcnt, errstr);  // Reset the target device
+        CP2130::ResetTiming timing = device.resetAndReopen(std::chrono::milliseconds(timeout), errcnt, errstr);
         if (errcnt > 0) {  // In case of error
-            if (device.disconnected()) {  // If the device disconnected
-                std::cerr << "Error: Device disconnected.\n";
+            if (timing.departure != 0 && timing.ready == 0) {  // The device was reset, but did not come back in time
+                output.error(ERRCODE_TIMEOUT, "Device did not come back after reset.\n");
             } else {
-                printErrors(errstr);
+                reportDeviceErrors(device, errstr, output);
             }
             errlvl = EXIT_FAILURE;
-        } else {  // Operation successful
-            std::cout << "Reset issued." << std::endl;
+        } else if (output.format() != Output::TEXT) {
+            output.record(Record().boolean("reset", true).integer("departure_us", timing.departure).integer("ready_us", timing.ready));
+        } else {
+            std::cout << std::fixed << std::setprecision(3);
+            std::cout << "Reset issued.\n";
+            std::cout << "Time to disconnect: " << timing.departure / 1000.0 << "ms\n";  // Time from the reset request until the device left the bus
+            std::cout << "Time to ready: " << timing.ready / 1000.0 << "ms\n";  // Time from the reset request until the device was reopened
         }
         device.close();
     } else {  // Failed to open device
-        if (err == ITUSB2Device::ERROR_INIT) {  // Failed to initialize libusb
-            std::cerr << "Error: Could not initialize libusb\n";
-        } else if (err == ITUSB2Device::ERROR_NOT_FOUND) {  // Failed to find device
-            std::cerr << "Error: Could not find device.\n";
-        } else if (err == ITUSB2Device::ERROR_BUSY) {  // Failed to claim interface
-            std::cerr << "Error: Device is currently unavailable.\n";
-        }
+        printOpenError(err, output);
         errlvl = EXIT_FAILURE;
     }
     return errlvl;
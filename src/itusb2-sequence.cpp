@@ -0,0 +1,237 @@
+/* ITUSB2 Sequence Command - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "output.h"
+#include "sequencer.h"
+#include "statistics.h"
+
+// Definitions
+const double MAX_TIME = 86400000;  // Longest offset or timeout of a step, in milliseconds [one day]
+
+// Global variables
+static std::atomic<bool> interrupted(false);  // Set when SIGINT or SIGTERM is received
+
+// Function prototypes
+void handleSignal(int signum);
+bool parseStep(const std::string &line, Sequencer::Step &step, std::string &action);
+bool parseTime(std::istream &stream, double &value);
+bool readTimeline(std::istream &in, std::vector<Sequencer::Step> &steps, std::vector<std::string> &names, std::string &errstr);
+
+int main(int argc, char **argv)
+{
+    int format = Output::TEXT;
+    bool valid = true;
+    static const option longOptions[] = {
+        {"format", required_argument, nullptr, 'f'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "f:", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            valid = Output::parseFormat(optarg, format);
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || argc - optind < 1 || argc - optind > 2) {
+        printUsageError(format, "Usage: itusb2-sequence [-f text|csv|json] FILE [SERIALNUMBER]\n");
+        return EXIT_USERERR;
+    }
+    Output output(format, std::cout, std::cerr);
+    std::string filename = argv[optind];
+    std::ifstream file;
+    if (filename != "-") {  // The timeline is read from the standard input if the file name is "-"
+        file.open(filename);
+        if (!file.is_open()) {
+            output.error(ERRCODE_FILE, "Could not open \"" + filename + "\" for reading.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    std::vector<Sequencer::Step> steps;
+    std::vector<std::string> names;  // Action name of each step, as given in the timeline
+    std::string errstr;
+    if (!readTimeline(filename == "-" ? std::cin : file, steps, names, errstr)) {  // The timeline is validated as a whole before the device is touched
+        output.error(ERRCODE_FILE, errstr);
+        return EXIT_FAILURE;
+    }
+    int errlvl = EXIT_SUCCESS;
+    ITUSB2Device device;
+    int err = openDevice(device, optind + 1 < argc ? argv[optind + 1] : std::string());  // Open the device having the specified serial number (or the first device found, if none was specified), taking it over from the daemon if necessary
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        signal(SIGINT, handleSignal);  // The timeline can be stopped at any time, and the results of the steps executed so far are still reported
+        signal(SIGTERM, handleSignal);
+        int errcnt = 0;
+        device.setup(errcnt, errstr);  // Prepare the device, so that current samples can be taken without delaying their steps
+        std::vector<Sequencer::StepResult> results;
+        if (errcnt == 0) {
+            Sequencer sequencer(device);
+            results = sequencer.run(steps, interrupted, errcnt, errstr);
+        }
+        Statistics errors;
+        bool unmet = false;
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Sequencer::StepResult &result = results[i];
+            double error = (result.started - result.scheduled) / 1000.0, duration = (result.finished - result.started) / 1000.0;  // In microseconds
+            errors.add(error);
+            unmet = unmet || !result.met;
+            if (format != Output::TEXT) {
+                output.record(Record().integer("step", i + 1).string("action", names[i]).number("scheduled_ms", result.scheduled / 1e6, 3).number("started_ms", result.started / 1e6, 3).number("error_us", error, 1).number("duration_us", duration, 1).boolean("met", result.met).number("current_ma", result.current, 1));
+            } else {
+                std::cout << "Step " << i + 1 << " (" << names[i] << ") at " << std::fixed << std::setprecision(3) << result.scheduled / 1e6 << "ms: started " << std::setprecision(1) << error << "us late, took " << duration << "us";
+                if (steps[i].action == Sequencer::WAIT) {
+                    std::cout << (result.met ? ", condition met" : ", timed out");
+                } else if (steps[i].action == Sequencer::SAMPLE) {
+                    std::cout << ", current " << result.current << "mA";
+                }
+                std::cout << "\n";
+            }
+        }
+        if (format == Output::TEXT && errors.count() > 0) {
+            std::cout << std::fixed << std::setprecision(1) << "Timing error: mean " << errors.mean() << "us, max " << errors.max() << "us (" << errors.count() << " of " << steps.size() << " steps executed)\n";
+        }
+        reportRealtime(device);
+        reportRecovery(device);
+        if (errcnt > 0) {  // In case of error
+            reportDeviceErrors(device, errstr, output);
+            errlvl = EXIT_FAILURE;
+        } else if (unmet || results.size() < steps.size()) {  // A condition that was not met, or an interrupted timeline, is reported through the exit status
+            errlvl = EXIT_FAILURE;
+        }
+        device.close();
+    } else {  // Failed to open device
+        printOpenError(err, output);
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
+
+// Signal handler that requests the timeline to stop
+void handleSignal(int signum)
+{
+    (void)signum;
+    interrupted = true;
+}
+
+// Parses a single step of the timeline, given as "OFFSET ACTION [ARGUMENTS]", returning false if it is not valid
+// The offset is given in milliseconds, and can have a fractional part
+bool parseStep(const std::string &line, Sequencer::Step &step, std::string &action)
+{
+    std::istringstream stream(line);
+    double offset = 0;
+    bool valid = parseTime(stream, offset) && static_cast<bool>(stream >> action);
+    step.offset = std::chrono::microseconds(static_cast<int64_t>(offset * 1000 + 0.5));
+    step.mask = step.value = 0;
+    step.timeout = std::chrono::microseconds(0);
+    if (action == "upon") {
+        step.action = Sequencer::POWER_ON;
+    } else if (action == "upoff") {
+        step.action = Sequencer::POWER_OFF;
+    } else if (action == "udon") {
+        step.action = Sequencer::DATA_ON;
+    } else if (action == "udoff") {
+        step.action = Sequencer::DATA_OFF;
+    } else if (action == "sample") {
+        step.action = Sequencer::SAMPLE;
+    } else if (action == "wait") {  // Given as "wait SIGNAL on|off TIMEOUT", where the timeout is in milliseconds
+        std::string signal, state;
+        double timeout = 0;
+        valid = valid && static_cast<bool>(stream >> signal >> state) && (state == "on" || state == "off") && parseTime(stream, timeout);
+        bool activeLow = true;
+        if (signal == "power") {
+            step.mask = ITUSB2Device::SIGNAL_UPEN;
+        } else if (signal == "data") {
+            step.mask = ITUSB2Device::SIGNAL_UDEN;
+        } else if (signal == "fault") {
+            step.mask = ITUSB2Device::SIGNAL_UDOC;
+        } else if (signal == "connected") {
+            step.mask = ITUSB2Device::SIGNAL_UDCD;
+            activeLow = false;
+        } else if (signal == "high_speed") {
+            step.mask = ITUSB2Device::SIGNAL_UDHS;
+            activeLow = false;
+        } else {
+            valid = false;
+        }
+        step.action = Sequencer::WAIT;
+        step.value = (state == "on") != activeLow ? step.mask : 0;
+        step.timeout = std::chrono::microseconds(static_cast<int64_t>(timeout * 1000 + 0.5));
+    } else {
+        valid = false;
+    }
+    std::string extra;
+    return valid && !(stream >> extra);  // No trailing arguments are allowed
+}
+
+// Parses a time in milliseconds, which can have a fractional part, returning false if it is negative, not finite or longer than MAX_TIME
+// This bounds the time before it is converted to an integer count of microseconds, which could otherwise overflow
+bool parseTime(std::istream &stream, double &value)
+{
+    bool valid = static_cast<bool>(stream >> value) && std::isfinite(value) && value >= 0 && value <= MAX_TIME;
+    if (!valid) {
+        value = 0;
+    }
+    return valid;
+}
+
+// Reads a timeline, one step per line, ignoring empty lines and comments (starting with "#") - Returns false if any step is not valid, or if the steps are not in chronological order
+bool readTimeline(std::istream &in, std::vector<Sequencer::Step> &steps, std::vector<std::string> &names, std::string &errstr)
+{
+    bool valid = true;
+    std::string line;
+    size_t number = 0;
+    while (valid && std::getline(in, line)) {
+        ++number;
+        line.erase(std::min(line.find('#'), line.size()));  // Strip comments
+        if (line.find_first_not_of(" \t\r") != std::string::npos) {  // Skip empty lines
+            Sequencer::Step step;
+            std::string name;
+            valid = parseStep(line, step, name);
+            if (!valid) {
+                errstr = "Invalid step in line " + std::to_string(number) + " of the timeline.\n";
+            } else if (!steps.empty() && step.offset < steps.back().offset) {  // The steps are run in the given order, so an earlier offset would never be honored
+                errstr = "Step in line " + std::to_string(number) + " of the timeline is out of order.\n";
+                valid = false;
+            } else {
+                steps.push_back(step);
+                names.push_back(name);
+            }
+        }
+    }
+    if (valid && steps.empty()) {
+        errstr = "The timeline has no steps.\n";
+        valid = false;
+    }
+    return valid;
+}
@@ -1,4 +1,4 @@
-/* ITUSB2 Status Command - Version 2.1 for Debian Linux
+/* ITUSB2 Status Command - Version 2.3 for Debian Linux
    Copyright (c) 2020-2022 Samuel Lourenço
 
    This program is free software: you can redistribute it and/or modify it
@@ -19,70 +19,332 @@
 
 
 // Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
 #include <cstdlib>
+#include <future>
+#include <getopt.h>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
-#include "error.h"
+#include <thread>
+#include <vector>
+#include "commands.h"
 #include "itusb2device.h"
+#include "output.h"
+#include "protocol.h"
+
+// Global variables
+static std::atomic<bool> interrupted(false);  // Set when SIGINT or SIGTERM is received
+
+// Function prototypes
+int errorCode(const std::string &error);
+void handleSignal(int signum);
+bool parseNumber(const char *str, float &value);
+bool parseNumber(const char *str, unsigned long &value);
+int printAllStatus(Output &output, unsigned long timeout);
+void printWatchLine(double time, const ITUSB2Device::Status &status, unsigned long edges, uint64_t transfers, double duration);
+void queryDaemonStatus(const std::string &serial, std::shared_ptr<std::promise<ITUSB2Device::DeviceStatus>> promise);
+int watchStatus(const std::string &serial, Output &output, unsigned long interval, bool changes, float delta);
 
 int main(int argc, char **argv)
 {
-    int err, errlvl = EXIT_SUCCESS;
-    ITUSB2Device device;
-    if (argc < 2) {  // If the program was called without arguments
-        err = device.open();  // Open a device and get the device handle
-    } else {  // Serial number was specified as argument
-        err = device.open(argv[1]);  // Open the device having the specified serial number, and get the device handle
+    bool all = false, watch = false, changes = false, allOpts = false, watchOpts = false, valid = true;
+    unsigned long interval = 1000;  // Refresh interval, in milliseconds
+    unsigned long timeout = 2000;  // Time limit for each device query, in milliseconds
+    float delta = 1;  // Minimum current variation that is considered a change, in mA
+    std::string format = "text";
+    int fmt = Output::TEXT;
+    static const option longOptions[] = {
+        {"all", no_argument, nullptr, 'a'},
+        {"changes", no_argument, nullptr, 'c'},
+        {"delta", required_argument, nullptr, 'd'},
+        {"format", required_argument, nullptr, 'f'},
+        {"interval", required_argument, nullptr, 'i'},
+        {"timeout", required_argument, nullptr, 't'},
+        {"watch", no_argument, nullptr, 'w'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "acd:f:i:t:w", longOptions, nullptr)) != -1) {
+        if (opt == 'a') {
+            all = true;
+        } else if (opt == 'c') {
+            changes = watchOpts = true;
+        } else if (opt == 'd') {
+            valid = parseNumber(optarg, delta);
+            watchOpts = true;
+        } else if (opt == 'f') {
+            format = optarg;
+            valid = Output::parseFormat(format, fmt);
+        } else if (opt == 'i') {
+            valid = parseNumber(optarg, interval) && interval > 0;
+            watchOpts = true;
+        } else if (opt == 't') {
+            valid = parseNumber(optarg, timeout) && timeout > 0;
+            allOpts = true;
+        } else if (opt == 'w') {
+            watch = true;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
     }
-    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
-        int errcnt = 0;
-        std::string errstr;
-        device.setup(errcnt, errstr);  // Prepare the device (SPI setup)
-        bool up = device.getUSBPowerStatus(errcnt, errstr);  // Get VBUS status
-        bool ud = device.getUSBDataStatus(errcnt, errstr);  // Data lines status
-        bool cd = device.getDUTConnectionStatus(errcnt, errstr);  // Device connection status
-        bool hs = device.getDUTSpeedStatus(errcnt, errstr);  // Device link speed status
-        float curr = device.getCurrent(errcnt, errstr);  // VBUS current reading
-        bool oc = device.getOvercurrentStatus(errcnt, errstr);  // Over-current flag
-        if (errcnt > 0) {  // In case of error
-            if (device.disconnected()) {  // If the device disconnected
-                std::cerr << "Error: Device disconnected.\n";
+    if (!valid || (all && (watch || optind < argc)) || argc - optind > 1 || (watchOpts && !watch) || (allOpts && !all)) {  // Some options only apply to either the "all devices" mode or the watch mode
+        printUsageError(fmt, "Usage: itusb2-status [-f text|csv|json] [-w [-i MILLISECONDS] [-c [-d MILLIAMPS]]] [SERIALNUMBER]\n       itusb2-status -a [-f text|csv|json] [-t MILLISECONDS]\n");
+        return EXIT_USERERR;
+    }
+    std::string serial = optind < argc ? argv[optind] : std::string();  // Specifying a serial number is optional
+    Output output(fmt, std::cout, std::cerr);
+    int errlvl;
+    if (all) {
+        errlvl = printAllStatus(output, timeout);
+    } else if (watch) {
+        errlvl = watchStatus(serial, output, interval, changes, delta);
+    } else {
+        errlvl = runCommand(serial, {"status", format});  // Print device status (the command is forwarded to the daemon, if running)
+    }
+    return errlvl;
+}
+
+// Returns the error code corresponding to the reason given by ITUSB2Device::getAllStatus(), or zero if there is no error
+int errorCode(const std::string &error)
+{
+    int code = ERRCODE_DEVICE;
+    if (error.empty()) {
+        code = 0;
+    } else if (error == "busy") {
+        code = ERRCODE_BUSY;
+    } else if (error == "disconnected") {
+        code = ERRCODE_DISCONNECTED;
+    } else if (error == "not found") {
+        code = ERRCODE_NOT_FOUND;
+    } else if (error == "timeout") {
+        code = ERRCODE_TIMEOUT;
+    }
+    return code;
+}
+
+// Signal handler that requests the watch mode to stop
+void handleSignal(int signum)
+{
+    (void)signum;
+    interrupted = true;
+}
+
+// Parses a non-negative decimal number, returning false if the given string is not valid
+bool parseNumber(const char *str, float &value)
+{
+    char *end;
+    value = std::strtof(str, &end);
+    return ((*str >= '0' && *str <= '9') || *str == '.') && *end == '\0';
+}
+
+// Parses a non-negative integer, returning false if the given string is not valid
+bool parseNumber(const char *str, unsigned long &value)
+{
+    char *end;
+    value = std::strtoul(str, &end, 10);
+    return *str >= '0' && *str <= '9' && *end == '\0';
+}
+
+// Queries all devices concurrently, and prints the status of each one - Returns the exit status
+// Devices that are found busy are queried again through the daemon, if it is running, since these are usually held by it
+// Unlike a device query, a query through the daemon is not bound by any transfer timeout, and its thread can't be joined if the daemon never responds
+// In that case, the process exits through std::quick_exit() once the results are printed, which is the only way a query thread is ever abandoned
+int printAllStatus(Output &output, unsigned long timeout)
+{
+    bool stuck = false;
+    int errcnt = 0, errlvl = EXIT_SUCCESS;
+    std::string errstr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);  // Queries through the daemon are bound by the same time limit
+    std::vector<ITUSB2Device::DeviceStatus> devices = ITUSB2Device::getAllStatus(std::chrono::milliseconds(timeout), errcnt, errstr);
+    std::vector<std::pair<size_t, std::future<ITUSB2Device::DeviceStatus>>> futures;
+    std::vector<std::thread> threads;
+    if (!daemonSocketPath().empty()) {
+        for (size_t i = 0; i < devices.size(); ++i) {
+            if (devices[i].error == "busy" && !devices[i].serial.empty()) {  // A device without a serial number can't be addressed through the daemon
+                std::shared_ptr<std::promise<ITUSB2Device::DeviceStatus>> promise = std::make_shared<std::promise<ITUSB2Device::DeviceStatus>>();  // Shared, so that a query that times out can still complete safely
+                futures.push_back(std::make_pair(i, promise->get_future()));
+                threads.push_back(std::thread(queryDaemonStatus, devices[i].serial, promise));
+            }
+        }
+    }
+    for (std::pair<size_t, std::future<ITUSB2Device::DeviceStatus>> &future : futures) {
+        if (future.second.wait_until(deadline) == std::future_status::ready) {
+            ITUSB2Device::DeviceStatus device = future.second.get();
+            if (device.valid) {  // Otherwise, the device remains reported as busy
+                devices[future.first] = device;
+            }
+        } else {
+            stuck = true;
+        }
+    }
+    if (errcnt > 0) {  // In case of error
+        output.error(ERRCODE_DEVICE, errstr);
+        errlvl = EXIT_FAILURE;
+    } else if (output.format() != Output::TEXT) {  // One record per device
+        for (const ITUSB2Device::DeviceStatus &device : devices) {
+            Record record = device.valid ? statusRecord(device.status) : Record().boolean("power", false).boolean("data", false).boolean("connected", false).boolean("high_speed", false).number("current_ma", 0, 1).boolean("fault", false);  // The fields are always the same, so that CSV output has a single header
+            output.record(Record().string("serial", device.serial).boolean("valid", device.valid).integer("error_code", errorCode(device.error)).string("error", device.error).append(record));
+        }
+    } else if (devices.empty()) {
+        std::cout << "No devices found.\n";
+    } else {
+        size_t width = 13;  // Width of the serial number column, which is at least the width of its heading
+        for (const ITUSB2Device::DeviceStatus &device : devices) {
+            width = std::max(width, device.serial.size());
+        }
+        std::cout << std::left << std::setw(width) << "Serial number" << "  Power  Data  Device        Link mode       Current  Fault\n";
+        for (const ITUSB2Device::DeviceStatus &device : devices) {
+            std::cout << std::left << std::setw(width) << device.serial << "  ";
+            if (device.valid) {
+                std::ostringstream current;
+                if (device.status.current < 1000) {  // If the current reading is lesser than 1000mA
+                    current << std::fixed << std::setprecision(1) << device.status.current << "mA";
+                } else {  // Otherwise
+                    current << "OL";  // Out of limits reading
+                }
+                std::cout << std::setw(5) << (device.status.up ? "On" : "Off") << "  "
+                          << std::setw(4) << (device.status.ud ? "On" : "Off") << "  "
+                          << std::setw(12) << (device.status.cd ? "Detected" : "Not detected") << "  "
+                          << std::setw(14) << (device.status.up && device.status.ud && device.status.cd ? (device.status.hs ? "High speed" : "Full/low speed") : "-") << "  "
+                          << std::right << std::setw(7) << current.str() << "  "
+                          << (device.status.oc ? "Yes" : "No") << "\n";
             } else {
-                printErrors(errstr);
+                std::cout << "Error: " << device.error << "\n";
             }
+        }
+        std::cout.flush();
+    }
+    for (const ITUSB2Device::DeviceStatus &device : devices) {
+        if (!device.valid) {  // The exit status reflects any device that could not be queried
             errlvl = EXIT_FAILURE;
-        } else {  // Operation successful
-            std::cout << "Status: Connection " << (up && ud ? "enabled" : "disabled") << std::endl;  // Print USB connection status
-            std::cout << "USB power: " << (up ? "Enabled" : "Disabled") << std::endl;  // Print USB power status
-            std::cout << "USB data: " << (ud ? "Enabled" : "Disabled") << std::endl;  // Print USB data status
-            std::cout << "Device: " << (cd ? "Detected" : "Not detected") << std::endl;  // Print device detection status (note that a device can be detected even if the USB data lines are disabled)
-            if (up && ud && cd) {  // If USB connection is fully enabled and a device is detected
-                std::cout << "Link mode: "  << (hs ? "High speed" : "Full/low speed") << std::endl;  // Print USB link mode
+        }
+    }
+    if (stuck) {  // A query through the daemon is still running, and is deliberately abandoned, since joining its thread could block indefinitely
+        std::cout.flush();
+        std::cerr.flush();
+        std::quick_exit(errlvl);  // Unlike exit(), this does not destroy any object that the abandoned thread might still be using
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return errlvl;
+}
+
+// Prints the device status in a single line, along with the number of connection edges since the last line, and the number of transfers and the time taken by the refresh
+void printWatchLine(double time, const ITUSB2Device::Status &status, unsigned long edges, uint64_t transfers, double duration)
+{
+    std::cout << std::fixed << std::setprecision(3) << time << "s: Power " << (status.up ? "on" : "off") << ", data " << (status.ud ? "on" : "off") << ", device " << (status.cd ? "detected" : "not detected");
+    if (status.up && status.ud && status.cd) {  // If USB connection is fully enabled and a device is detected
+        std::cout << " (" << (status.hs ? "high speed" : "full/low speed") << ")";  // Link mode
+    }
+    std::cout << ", current ";
+    if (status.current < 1000) {  // If the current reading is lesser than 1000mA
+        std::cout << std::setprecision(1) << status.current << "mA" << (status.current > 500 ? " (OC)" : "");
+    } else {  // Otherwise
+        std::cout << "OL";  // Out of limits reading
+    }
+    if (status.oc) {
+        std::cout << ", fault detected";  // Over-current or over-temperature trip condition detected
+    }
+    if (edges > 0) {
+        std::cout << ", " << edges << " connection edge" << (edges == 1 ? "" : "s");  // Connections (including short glitches) since the previous line
+    }
+    std::cout << " [" << transfers << " transfers, " << std::setprecision(3) << duration << "ms]\n";
+    std::cout.flush();  // Each line is delivered as soon as it is complete
+}
+
+// Gets the status of the device having the given serial number through the daemon, and delivers it through the given promise (used by printAllStatus())
+// The returned status is only valid if the daemon is running and holds or could open the device
+void queryDaemonStatus(const std::string &serial, std::shared_ptr<std::promise<ITUSB2Device::DeviceStatus>> promise)
+{
+    ITUSB2Device::DeviceStatus device = {serial, false, "busy", {false, false, false, false, false, 0}};
+    int errlvl;
+    std::string out, err;
+    if (queryDaemon(serial, {"status", "csv"}, errlvl, out, err) && errlvl == EXIT_SUCCESS) {
+        std::istringstream stream(out);
+        std::string header, values;
+        if (std::getline(stream, header) && header == "power,data,connected,high_speed,current_ma,fault" && std::getline(stream, values)) {  // The fields of statusRecord()
+            std::replace(values.begin(), values.end(), ',', ' ');
+            std::istringstream fields(values);
+            fields >> device.status.up >> device.status.ud >> device.status.cd >> device.status.hs >> device.status.current >> device.status.oc;
+            if (fields) {
+                device.valid = true;
+                device.error.clear();
             }
-            std::cout << "Current: ";
-            if (curr < 1000) {  // If the current reading is lesser than 1000mA
-                std::cout << std::fixed << std::setprecision(1) << curr << "mA";  // Print the current reading
-                if (curr > 500) {
-                    std::cout << " (OC)";  // Print "(OC)" next to the value, to indicate that the current exceeds the 500mA limit established by the USB 2.0 specification (and also may cause a trip)
+        }
+    }
+    promise->set_value(device);
+}
+
+// Opens and sets up the device once, and then refreshes its status at the given interval, until interrupted
+// Each refresh takes a single GPIO snapshot followed by a current reading - If "changes" is true, a line (or record) is only printed when the status changes
+int watchStatus(const std::string &serial, Output &output, unsigned long interval, bool changes, float delta)
+{
+    int errlvl = EXIT_SUCCESS;
+    ITUSB2Device device;
+    int err = openDevice(device, serial);  // Open the device, taking it over from the daemon if necessary
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+        int errcnt = 0;
+        std::string errstr;
+        ITUSB2Device::SetupReport report = device.setup(errcnt, errstr);  // Prepare the device (SPI setup), only once
+        if (errcnt == 0 && output.format() == Output::TEXT) {  // Report whether the setup was needed, along with the number of transfers it took
+            std::cout << "Setup " << (report.wakeupSkipped ? "skipped (already applied)" : "applied") << ", " << device.transfers() << " transfers.\n";
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), next = start;
+        device.armConnectionCounter(errcnt, errstr);  // Count connections between refreshes, so that glitches are not missed
+        ITUSB2Device::Status previous = {false, false, false, false, false, 0};
+        bool printed = false;  // Set after the first line is printed
+        uint16_t count = 0;  // Last value of the event counter
+        unsigned long edges = 0;  // Connection edges since the last printed line
+        while (errcnt == 0 && !interrupted) {
+            uint64_t transfers = device.transfers();
+            std::chrono::steady_clock::time_point refresh = std::chrono::steady_clock::now();
+            ITUSB2Device::Status status = device.getStatus(errcnt, errstr);
+            CP2130::EventCounter counter = device.getConnectionCounter(errcnt, errstr);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            if (errcnt == 0) {
+                edges += static_cast<uint16_t>(counter.value - count);  // The counter wraps around, which is harmless as long as there are less than 65536 edges between refreshes
+                count = counter.value;
+                bool changed = !printed || edges > 0 || status.up != previous.up || status.ud != previous.ud || status.cd != previous.cd || status.hs != previous.hs || status.oc != previous.oc || std::fabs(status.current - previous.current) >= delta;
+                if (!changes || changed) {
+                    double time = std::chrono::duration<double>(refresh - start).count(), duration = std::chrono::duration<double, std::milli>(end - refresh).count();
+                    if (output.format() != Output::TEXT) {
+                        output.record(Record().number("time_s", time, 3).append(statusRecord(status)).integer("connect_edges", edges).integer("transfers", device.transfers() - transfers).number("duration_ms", duration, 3));
+                    } else {
+                        printWatchLine(time, status, edges, device.transfers() - transfers, duration);
+                    }
+                    previous = status;  // Note that the current is compared against the last printed value, so that slow drifts are also reported
+                    edges = 0;
+                    printed = true;
                 }
-            } else {  // Otherwise
-                std::cout << "OL";  // Print "OL" to indicate an out of limits reading
             }
-            std::cout << std::endl;
-            if (oc) {
-                std::cout << "Warning: Fault detected!" << std::endl;  // Over-current or over-temperature trip condition detected
+            device.idleADC(std::chrono::milliseconds(interval), errcnt, errstr);  // Let the LTC2312 nap or sleep until the next refresh, if worthwhile
+            next += std::chrono::milliseconds(interval);
+            if (next < end) {  // If the refresh took longer than the interval, skip the missed refreshes instead of trying to catch up
+                next = end;
+            }
+            while (!interrupted && std::chrono::steady_clock::now() < next) {  // The sleep is split, so that the program responds promptly to interruptions
+                std::this_thread::sleep_until(std::min(next, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
             }
         }
+        reportRealtime(device);
+        reportRecovery(device);
+        if (errcnt > 0) {  // In case of error
+            reportDeviceErrors(device, errstr, output);
+            errlvl = EXIT_FAILURE;
+        }
         device.close();
     } else {  // Failed to open device
-        if (err == ITUSB2Device::ERROR_INIT) {  // Failed to initialize libusb
-            std::cerr << "Error: Could not initialize libusb\n";
-        } else if (err == ITUSB2Device::ERROR_NOT_FOUND) {  // Failed to find device
-            std::cerr << "Error: Could not find device.\n";
-        } else if (err == ITUSB2Device::ERROR_BUSY) {  // Failed to claim interface
-            std::cerr << "Error: Device is currently unavailable.\n";
-        }
+        printOpenError(err, output);
         errlvl = EXIT_FAILURE;
     }
     return errlvl;
@@ -0,0 +1,183 @@
+/* ITUSB2 Multi-Command Tool - Version 1.0 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "output.h"
+
+// Function prototypes
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+bool parseDelay(const std::string &str, unsigned long &value);
+int runBatch(const std::string &serial, std::istream &script, Output &output, const std::string &format, bool stopOnError, bool timing);
+
+int main(int argc, char **argv)
+{
+    bool batch = false, stopOnError = false, timing = false, valid = true;
+    std::string serial, format;
+    int fmt = Output::TEXT;
+    static const option longOptions[] = {
+        {"batch", no_argument, nullptr, 'b'},
+        {"format", required_argument, nullptr, 'f'},
+        {"stop-on-error", no_argument, nullptr, 'e'},
+        {"serial", required_argument, nullptr, 's'},
+        {"timing", no_argument, nullptr, 't'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "+bef:s:t", longOptions, nullptr)) != -1) {  // The "+" stops option parsing at the command name, so that command parameters are passed as they are
+        if (opt == 'b') {
+            batch = true;
+        } else if (opt == 'e') {
+            stopOnError = true;
+        } else if (opt == 'f') {
+            format = optarg;
+            valid = Output::parseFormat(format, fmt);
+        } else if (opt == 's') {
+            serial = optarg;
+        } else if (opt == 't') {
+            timing = true;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    if (!valid || (batch && argc - optind > 1) || (!batch && (optind >= argc || stopOnError || timing))) {
+        printUsageError(fmt, "Usage: itusb2 [-s SERIALNUMBER] [-f text|csv|json] COMMAND [PARAMETERS]\n       itusb2 [-s SERIALNUMBER] [-f text|csv|json] -b [-e] [-t] [SCRIPT]\n");
+        return EXIT_USERERR;
+    }
+    Output output(fmt, std::cout, std::cerr);
+    int errlvl;
+    if (batch) {
+        std::string path = optind < argc ? argv[optind] : "-";
+        if (path == "-") {  // Read the script from the standard input
+            errlvl = runBatch(serial, std::cin, output, format, stopOnError, timing);
+        } else {
+            std::ifstream script(path);
+            if (script.is_open()) {
+                errlvl = runBatch(serial, script, output, format, stopOnError, timing);
+            } else {
+                output.error(ERRCODE_FILE, "Could not open \"" + path + "\".\n");
+                errlvl = EXIT_FAILURE;
+            }
+        }
+    } else {
+        std::vector<std::string> args(argv + optind, argv + argc);
+        if (!format.empty() && commandFormat(args) == Output::TEXT) {  // The format given as an option applies, unless given as a parameter
+            args.push_back(format);
+        }
+        errlvl = runCommand(serial, args);  // Execute a single command (forwarded to the daemon, if running)
+    }
+    return errlvl;
+}
+
+// Returns the time elapsed between "start" and "end", in milliseconds
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Parses a delay given in milliseconds, returning true if successful
+bool parseDelay(const std::string &str, unsigned long &value)
+{
+    bool retval = false;
+    if (!str.empty() && str.find_first_not_of("0123456789") == std::string::npos && str.size() <= 9) {  // Up to 999999999ms (about 11 days)
+        value = std::stoul(str);
+        retval = true;
+    }
+    return retval;
+}
+
+// Executes the commands contained in the given script, one per line, against a single open device, and returns the exit status
+// Besides the usual commands, "wait MILLISECONDS" pauses the execution for the given time, counted from the end of the previous command
+// Empty lines and lines starting with "#" are ignored, and the given format applies to any command that does not specify one
+int runBatch(const std::string &serial, std::istream &script, Output &output, const std::string &format, bool stopOnError, bool timing)
+{
+    int errlvl = EXIT_SUCCESS;
+    ITUSB2Device device;
+    int err = openDevice(device, serial);  // Open the device, taking it over from the daemon if necessary (the whole script is executed without releasing it)
+    if (err == ITUSB2Device::SUCCESS) {  // Device was successfully opened
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now(), previous = begin;  // Beginning of the script, and end of the previous step
+        std::string line;
+        size_t lineno = 0, step = 0;
+        while (std::getline(script, line)) {
+            ++lineno;
+            std::istringstream stream(line);
+            std::vector<std::string> args;
+            std::string arg;
+            while (stream >> arg) {
+                args.push_back(arg);
+            }
+            if (args.empty() || args[0][0] == '#') {  // Empty line or comment
+                continue;
+            }
+            ++step;
+            int steplvl = EXIT_SUCCESS;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (args[0] == "wait") {
+                unsigned long delay;
+                if (args.size() == 2 && parseDelay(args[1], delay)) {
+                    std::this_thread::sleep_until(previous + std::chrono::milliseconds(delay));  // Sleeping until an absolute deadline means that the time spent parsing the script is not added to the delay
+                } else {
+                    output.error(ERRCODE_USAGE, "Invalid delay.\n");
+                    steplvl = EXIT_USERERR;
+                }
+            } else {
+                if (!format.empty() && commandFormat(args) == Output::TEXT) {
+                    args.push_back(format);
+                }
+                steplvl = executeCommand(device, args, std::cout, std::cerr);
+            }
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            if (timing && output.format() != Output::TEXT) {
+                output.record(Record().integer("step", step).integer("line", lineno).string("command", args[0]).number("start_ms", elapsedMilliseconds(begin, start), 3).number("duration_ms", elapsedMilliseconds(start, end), 3).integer("exit_status", steplvl));
+            } else if (timing) {
+                std::cout << std::fixed << std::setprecision(3) << "Step " << step << " (line " << lineno << "): " << args[0] << " started at " << elapsedMilliseconds(begin, start) << "ms, took " << elapsedMilliseconds(start, end) << "ms" << (steplvl == EXIT_SUCCESS ? "" : " (failed)") << "\n";
+                std::cout.flush();
+            }
+            previous = end;
+            if (steplvl != EXIT_SUCCESS) {
+                if (errlvl == EXIT_SUCCESS || steplvl == EXIT_FAILURE) {  // Device errors take precedence over usage errors in the exit status
+                    errlvl = steplvl;
+                }
+                if (stopOnError || device.disconnected()) {  // Nothing else can be done once the device disconnects
+                    output.error(device.disconnected() ? ERRCODE_DISCONNECTED : (steplvl == EXIT_USERERR ? ERRCODE_USAGE : ERRCODE_DEVICE), "Script stopped at line " + std::to_string(lineno) + ".\n");  // The error code reflects the reason why the script stopped
+                    break;
+                }
+            }
+        }
+        reportRealtime(device);
+        reportRecovery(device);
+        device.close();
+    } else {  // Failed to open device
+        printOpenError(err, output);
+        errlvl = EXIT_FAILURE;
+    }
+    return errlvl;
+}
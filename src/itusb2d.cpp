@@ -0,0 +1,602 @@
+/* ITUSB2 Daemon - Version 1.1 for Debian Linux
+   Copyright (c) 2022 Samuel Lourenço
+
+   This program is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation, either version 3 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <getopt.h>
+#include <grp.h>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "commands.h"
+#include "itusb2device.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "realtime.h"
+#include "worker.h"
+
+// Definitions
+const int DEFAULT_POLL_MS = 1000;   // Default polling interval, in milliseconds
+const std::chrono::seconds SCRAPE_TIMEOUT(1);  // Time allowed for a whole scrape request to be received, or for the response to be sent [1s]
+const size_t SCRAPE_MAX_REQUEST = 8192;         // Longest scrape request accepted, including the headers, in bytes
+
+// Connection served by its own thread
+struct Connection {
+    int fd;
+    std::thread thread;
+    bool finished;  // Set once the connection is closed, so that the thread can be joined
+};
+
+// Device kept open by the daemon (the mutex serializes the commands issued to it, except the switching commands and the polls, which go through the worker)
+struct DeviceEntry {
+    ITUSB2Device device;
+    std::mutex mutex;
+    std::string serial;   // Serial number under which the device is kept
+    uint64_t instance;    // Identifies each time a device is opened, so that its counters can be accumulated across reopenings
+    DeviceWorker worker;  // Declared after the device, so that it is stopped before the device is closed
+
+    DeviceEntry() : device(), mutex(), serial(), instance(0), worker(device) {}
+};
+
+// Metrics kept for each device ever seen by the daemon
+struct MetricsEntry {
+    DeviceMetrics snapshot;          // Last published metrics
+    ITUSB2Device::Counters base;     // Counters accumulated from previous instances
+    ITUSB2Device::Counters last;     // Counters last read from the current instance
+    uint64_t coalescedBase;          // Coalesced requests accumulated from previous instances
+    uint64_t coalescedLast;          // Coalesced requests last read from the worker of the current instance
+    uint64_t instance;               // Instance to which "last" refers
+    bool disconnected;               // True if the disconnection of the current instance was already counted
+};
+
+// Global variables
+static std::list<std::shared_ptr<Connection>> connections;           // Connections being served, including finished ones whose threads were not joined yet
+static std::mutex connectionsMutex;                                  // Protects "connections", and the "finished" flag of each connection
+static std::map<std::string, std::shared_ptr<DeviceEntry>> devices;  // Open devices, indexed by serial number
+static std::mutex devicesMutex;                                      // Protects "devices", "defaultSerial" and "instances"
+static std::string defaultSerial;                                    // Serial number of the default device, once known
+static uint64_t instances = 0;                                       // Number of times a device was opened
+static std::map<std::string, MetricsEntry> metrics;                  // Device metrics, indexed by serial number
+static std::mutex metricsMutex;                                      // Protects "metrics"
+static CP2130::RetryPolicy retryPolicy = {0, std::chrono::microseconds(0), std::chrono::microseconds(0)};  // Transfer retry policy applied to every device, as given by ITUSB2_RETRY
+static std::atomic<bool> terminated(false);                          // Set when SIGINT or SIGTERM is received (atomic, since it is also checked by the polling and metrics threads, and lock-free, so that it can be set by a signal handler)
+static gid_t allowedGroup = static_cast<gid_t>(-1);                  // Members of this group are allowed to use the daemon, besides root and the user running it (none, if -1)
+
+// Function prototypes
+std::shared_ptr<DeviceEntry> acquireDevice(const std::string &serial, int &err);
+bool authorizePeer(int fd);
+void forgetDevice(const std::string &serial);
+void handleConnection(int fd);
+void handleScrape(int fd);
+void handleSignal(int signum);
+void pollDevices(std::chrono::milliseconds interval);
+std::string processRequest(const std::string &serial, const std::vector<std::string> &args);
+bool readScrapeRequest(int fd, std::string &request);
+void reapConnections();
+void serveConnection(std::shared_ptr<Connection> connection);
+void serveMetrics(int listenfd);
+template <typename Function, typename... Args> std::thread startThread(Function function, Args... args);
+void updateMetrics(const DeviceEntry &entry, bool polled, const ITUSB2Device::Status *status);
+
+int main(int argc, char **argv)
+{
+    std::string path = daemonSocketPath(), metricsAddress;
+    bool foreground = false, valid = true;
+    long pollms = DEFAULT_POLL_MS;
+    static const option longOptions[] = {
+        {"foreground", no_argument, nullptr, 'f'},
+        {"metrics", required_argument, nullptr, 'm'},
+        {"poll", required_argument, nullptr, 'p'},
+        {"socket", required_argument, nullptr, 's'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int opt;
+    while (valid && (opt = getopt_long(argc, argv, "fm:p:s:", longOptions, nullptr)) != -1) {
+        if (opt == 'f') {
+            foreground = true;
+        } else if (opt == 'm') {
+            metricsAddress = optarg;
+            valid = !metricsAddress.empty();
+        } else if (opt == 'p') {
+            char *end;
+            pollms = std::strtol(optarg, &end, 10);
+            valid = *optarg != '\0' && *end == '\0' && pollms > 0;
+        } else if (opt == 's') {
+            path = optarg;
+        } else {  // Unknown option (an error message is printed by getopt_long())
+            valid = false;
+        }
+    }
+    sockaddr_un addr;
+    if (!valid || optind < argc || path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Invalid arguments.\nUsage: itusb2d [-f] [-m ADDRESS [-p MS]] [-s SOCKET]\n";
+        return EXIT_USERERR;
+    }
+    setenv("ITUSB2D_SOCKET", path.c_str(), 1);  // So that connectDaemon() checks the socket that is effectively used
+    int fd = connectDaemon();
+    if (fd >= 0) {  // Another instance is already listening on the same socket
+        close(fd);
+        std::cerr << "Error: Daemon is already running.\n";
+        return EXIT_FAILURE;
+    }
+    if (path == SYSTEM_SOCKET) {
+        mkdir(SYSTEM_SOCKET_DIR, 0755);  // Fails harmlessly if the directory already exists
+    }
+    unlink(path.c_str());  // Remove any stale socket left behind by a previous instance
+    int listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, path.size());
+    mode_t mask = umask(0077);  // The socket is only accessible by its owner until its group is set
+    bool bound = listenfd >= 0 && bind(listenfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    umask(mask);
+    if (!bound || listen(listenfd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Could not create socket \"" << path << "\".\n";
+        return EXIT_FAILURE;
+    }
+    group *grp = getgrnam(DAEMON_GROUP);
+    if (geteuid() == 0 && grp != nullptr && chown(path.c_str(), 0, grp->gr_gid) == 0) {  // Users that can access the devices (see the udev rules) should be able to use a system daemon
+        allowedGroup = grp->gr_gid;
+        chmod(path.c_str(), 0660);
+    }
+    int metricsfd = -1;
+    if (!metricsAddress.empty() && (metricsfd = listenMetrics(metricsAddress)) < 0) {
+        std::cerr << "Error: Could not create metrics socket \"" << metricsAddress << "\".\n";
+        close(listenfd);
+        unlink(path.c_str());
+        return EXIT_FAILURE;
+    }
+    if (!foreground && daemon(1, 0) != 0) {  // The working directory is kept, so that a relative socket path can be removed on exit
+        std::cerr << "Error: Could not run in the background.\n";
+        unlink(path.c_str());
+        return EXIT_FAILURE;
+    }
+    const char *retryenv = std::getenv("ITUSB2_RETRY");
+    ITUSB2Device::RetryPolicy policy;
+    if (retryenv != nullptr && *retryenv != '\0') {
+        if (ITUSB2Device::parseRetryPolicy(retryenv, policy)) {
+            retryPolicy = policy.transfers;
+        } else {
+            std::cerr << "Invalid ITUSB2_RETRY setting \"" << retryenv << "\", ignored.\n";  // Only visible when running in the foreground
+        }
+    }
+    RealtimeStatus realtime = enableRealtimeFromEnv();  // Applied after daemonizing, since memory locks are not inherited by the forked process, and before starting any threads, so that they inherit the scheduling policy and affinity
+    if (realtime.requested) {
+        std::cerr << describeRealtime(realtime) << ".\n";  // Only visible when running in the foreground
+    }
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;  // Note that SA_RESTART is not set, so that accept() is interrupted
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    std::thread poller, scraper;
+    if (metricsfd >= 0) {  // Devices are only polled if metrics are enabled, so that scrapes are served from the last poll and never cause a transfer
+        poller = startThread(pollDevices, std::chrono::milliseconds(pollms));
+        scraper = startThread(serveMetrics, metricsfd);
+    }
+    while (!terminated) {
+        int connfd = accept4(listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+        reapConnections();
+        if (connfd >= 0) {
+            std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+            connection->fd = connfd;
+            connection->finished = false;
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            connection->thread = startThread(serveConnection, connection);  // Each connection is served by its own thread, so that a lengthy command on one device does not delay commands on other devices
+            connections.push_back(connection);
+        }
+    }
+    close(listenfd);
+    unlink(path.c_str());
+    std::list<std::shared_ptr<Connection>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (const std::shared_ptr<Connection> &connection : connections) {
+            if (!connection->finished) {
+                shutdown(connection->fd, SHUT_RDWR);  // Clients are disconnected once any commands still running finish, instead of waiting for them to close their connections
+            }
+        }
+        remaining.swap(connections);
+    }
+    for (const std::shared_ptr<Connection> &connection : remaining) {
+        connection->thread.join();
+    }
+    if (metricsfd >= 0) {
+        shutdown(metricsfd, SHUT_RDWR);  // Wakes up the metrics thread, which is blocked in accept() (signals are only delivered to the main thread)
+        scraper.join();
+        close(metricsfd);
+        poller.join();  // Returns after the current poll interval, at most
+    }
+    if (metricsAddress.find('/') != std::string::npos) {
+        unlink(metricsAddress.c_str());
+    }
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    devices.clear();  // All threads were joined, so no other thread uses the devices or the metrics from this point on
+    return EXIT_SUCCESS;
+}
+
+// Returns the open device having the given serial number (or the default device, if the serial number is empty), opening it if necessary
+// Returns a null pointer if the device could not be opened, in which case "err" is set accordingly
+// The device is opened without holding "devicesMutex", so that requests for other devices are not delayed by its USB transfers
+std::shared_ptr<DeviceEntry> acquireDevice(const std::string &serial, int &err)
+{
+    std::shared_ptr<DeviceEntry> entry;
+    err = ITUSB2Device::SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(devicesMutex);
+        std::string key = serial.empty() ? defaultSerial : serial;
+        std::map<std::string, std::shared_ptr<DeviceEntry>>::iterator it = devices.find(key);
+        if (!key.empty() && it != devices.end()) {
+            entry = it->second;
+        }
+    }
+    if (!entry) {
+        std::shared_ptr<DeviceEntry> opened(new DeviceEntry);
+        std::string key = serial;
+        err = opened->device.open(serial);
+        if (err == ITUSB2Device::SUCCESS) {
+            if (serial.empty()) {  // Find out the serial number of the default device, so that it can be addressed either way
+                int errcnt = 0;
+                std::string errstr;
+                std::u16string serialDesc = opened->device.getSerialDesc(errcnt, errstr);
+                key = std::string(serialDesc.begin(), serialDesc.end());  // Serial numbers are plain ASCII
+            }
+            ITUSB2Device::RetryPolicy policy = {retryPolicy, std::chrono::milliseconds(0)};  // Devices are never reconnected automatically, since the daemon reopens them on its own
+            int errcnt = 0;
+            std::string errstr;
+            opened->device.setRetryPolicy(policy, errcnt, errstr);
+        } else if (serial.empty() && err == ITUSB2Device::ERROR_BUSY) {  // The default device may have been opened already, but by its serial number
+            int errcnt = 0;
+            std::string errstr;
+            std::list<std::string> serials = ITUSB2Device::listDevices(errcnt, errstr);
+            if (!serials.empty()) {
+                key = serials.front();
+            }
+        }
+        std::lock_guard<std::mutex> lock(devicesMutex);  // Released before "opened" is destroyed, so that a discarded device is also closed without holding the lock
+        std::map<std::string, std::shared_ptr<DeviceEntry>>::iterator it = devices.find(key);
+        if (!key.empty() && it != devices.end()) {  // Another request opened the device meanwhile (in which case this one usually failed with ERROR_BUSY), so its entry is used instead
+            entry = it->second;
+            err = ITUSB2Device::SUCCESS;
+        } else if (err == ITUSB2Device::SUCCESS) {
+            opened->serial = key;
+            opened->instance = ++instances;
+            opened->worker.start();
+            devices[key] = opened;
+            entry = opened;
+        }
+        if (entry && serial.empty()) {
+            defaultSerial = key;
+        }
+    }
+    return entry;
+}
+
+// Returns true if the process at the other end of the given connection is allowed to use the daemon
+// Besides the socket permissions, the credentials of the peer are checked, so that the daemon is never used by other users, even if the socket is made accessible to them
+bool authorizePeer(int fd)
+{
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    bool authorized = false;
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+        authorized = cred.uid == 0 || cred.uid == geteuid();
+        if (!authorized && allowedGroup != static_cast<gid_t>(-1)) {
+            authorized = cred.gid == allowedGroup;
+            passwd pwd, *result;
+            std::vector<char> buffer(16384);
+            if (!authorized && getpwuid_r(cred.uid, &pwd, buffer.data(), buffer.size(), &result) == 0 && result != nullptr) {  // Supplementary groups are not given by SO_PEERCRED, and must be looked up
+                int ngroups = 64;
+                std::vector<gid_t> groups(ngroups);
+                if (getgrouplist(pwd.pw_name, pwd.pw_gid, groups.data(), &ngroups) < 0) {  // The number of groups is updated if the vector is too small
+                    groups.resize(ngroups);
+                    getgrouplist(pwd.pw_name, pwd.pw_gid, groups.data(), &ngroups);
+                }
+                groups.resize(ngroups);
+                authorized = std::find(groups.begin(), groups.end(), allowedGroup) != groups.end();
+            }
+        }
+    }
+    return authorized;
+}
+
+// Closes the device having the given serial number (or the default device), as soon as no command is running on it
+void forgetDevice(const std::string &serial)
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    devices.erase(serial.empty() ? defaultSerial : serial);
+}
+
+// Serves all requests received through a connection, until the client closes it
+// The connection is not closed by this function (see serveConnection())
+void handleConnection(int fd)
+{
+    std::string buffer, line;
+    if (!authorizePeer(fd)) {  // The request is read anyway, so that the client gets a response instead of a lost connection
+        if (readLine(fd, buffer, line)) {
+            writeAll(fd, encodeResponse(EXIT_FAILURE, "", "Error: Permission denied.\n"));
+        }
+    } else {
+        while (readLine(fd, buffer, line)) {
+            std::string serial;
+            std::vector<std::string> args;
+            std::string response;
+            if (decodeRequest(line, serial, args)) {
+                response = processRequest(serial, args);
+            } else {
+                response = encodeResponse(EXIT_USERERR, "", "Error: Malformed request.\n");
+            }
+            if (!writeAll(fd, response)) {
+                break;
+            }
+        }
+    }
+}
+
+// Serves a single scrape, which is answered from the metrics obtained on the last poll
+void handleScrape(int fd)
+{
+    timeval timeout = {static_cast<time_t>(SCRAPE_TIMEOUT.count()), 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));  // A client that does not read the response is dropped as well
+    std::string request;
+    if (readScrapeRequest(fd, request)) {
+        std::istringstream stream(request);
+        std::string method, target, status, body;
+        stream >> method >> target;
+        if (method != "GET") {
+            status = "405 Method Not Allowed";
+        } else if (target != "/metrics" && target != "/") {
+            status = "404 Not Found";
+        } else {
+            status = "200 OK";
+            std::map<std::string, DeviceMetrics> snapshots;
+            {
+                std::lock_guard<std::mutex> lock(metricsMutex);
+                for (const std::pair<const std::string, MetricsEntry> &entry : metrics) {
+                    snapshots[entry.first] = entry.second.snapshot;
+                }
+            }
+            body = formatMetrics(snapshots);
+        }
+        std::ostringstream response;
+        response << "HTTP/1.0 " << status << "\r\n"
+                 << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "Connection: close\r\n\r\n"
+                 << body;
+        writeAll(fd, response.str());
+    }
+    close(fd);
+}
+
+// Signal handler that requests the daemon to terminate
+void handleSignal(int signum)
+{
+    (void)signum;
+    terminated = true;
+}
+
+// Polls the status of every device held by the daemon periodically
+// Devices are never opened by polling, so that a device that was released to another process, or that was never used through the daemon, is left alone
+void pollDevices(std::chrono::milliseconds interval)
+{
+    while (!terminated) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<std::shared_ptr<DeviceEntry>> entries;
+        {
+            std::lock_guard<std::mutex> lock(devicesMutex);
+            for (const std::pair<const std::string, std::shared_ptr<DeviceEntry>> &device : devices) {
+                entries.push_back(device.second);
+            }
+        }
+        for (const std::shared_ptr<DeviceEntry> &entry : entries) {  // The entry mutex is not taken, since ITUSB2Device is thread-safe, so polls are not delayed by lengthy commands (e.g., "enum"), nor do they delay them
+            int errcnt = 0;
+            std::string errstr;
+            if (!entry->device.isConfigured()) {
+                entry->device.setup(errcnt, errstr);
+            }
+            DeviceWorker::Result result = entry->worker.post(DeviceWorker::GET_STATUS).get();  // Through the worker, so that the poll is ordered with respect to the switching commands
+            if (!result.success) {
+                ++errcnt;
+                errstr += result.error;
+            }
+            updateMetrics(*entry, true, errcnt == 0 ? &result.status : nullptr);
+            entry->device.idleADC(interval, errcnt, errstr);  // Let the LTC2312 nap or sleep until the next poll
+            if (entry->device.disconnected()) {
+                forgetDevice(entry->serial);
+            }
+        }
+        std::this_thread::sleep_until(start + interval);
+    }
+}
+
+// Processes a single request, returning the encoded response
+std::string processRequest(const std::string &serial, const std::vector<std::string> &args)
+{
+    int errlvl;
+    std::ostringstream out, err;
+    if (args[0] == "release") {  // Releases the device, so that another process can open it
+        forgetDevice(serial);
+        errlvl = EXIT_SUCCESS;
+    } else {
+        int openerr;
+        std::shared_ptr<DeviceEntry> entry = acquireDevice(serial, openerr);
+        if (entry) {
+            std::unique_lock<std::mutex> lock(entry->mutex, std::defer_lock);
+            if (!isSwitchCommand(args)) {  // Switching commands are serialized by the worker instead, so that those issued concurrently by different clients can be coalesced
+                lock.lock();
+            }
+            errlvl = executeCommand(entry->device, args, out, err, &entry->worker);
+            updateMetrics(*entry, false, nullptr);  // Keeps the counters up to date between polls
+            if (args[0] == "reset" || entry->device.disconnected()) {  // The device must be opened again on the next request, which is always the case after a reset, since the device re-enumerates even if the reset request appeared to fail
+                forgetDevice(entry->serial);
+            }
+        } else {
+            Output output(commandFormat(args), out, err);
+            printOpenError(openerr, output);
+            errlvl = EXIT_FAILURE;
+        }
+    }
+    return encodeResponse(errlvl, out.str(), err.str());
+}
+
+// Reads the request line of a scrape, returning false if the request, including its headers (which are ignored), is not fully received in time, or is too long
+// The deadline applies to the whole request, so that a client that trickles its request can't hold up the scrapes of other clients
+bool readScrapeRequest(int fd, std::string &request)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + SCRAPE_TIMEOUT;
+    std::string buffer;
+    bool valid = true;
+    while (valid && buffer.find("\n\r\n") == std::string::npos && buffer.find("\n\n") == std::string::npos) {  // The headers end with an empty line
+        std::chrono::milliseconds remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        pollfd pfd = {fd, POLLIN, 0};
+        int ready = remaining.count() > 0 && buffer.size() < SCRAPE_MAX_REQUEST ? poll(&pfd, 1, static_cast<int>(remaining.count())) : 0;
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        char chunk[512];
+        ssize_t nbytes = ready > 0 ? read(fd, chunk, std::min(sizeof(chunk), SCRAPE_MAX_REQUEST - buffer.size())) : 0;
+        if (nbytes < 0 && errno == EINTR) {
+            continue;
+        }
+        valid = nbytes > 0;
+        if (valid) {
+            buffer.append(chunk, static_cast<size_t>(nbytes));
+        }
+    }
+    if (valid) {
+        request = buffer.substr(0, buffer.find('\n'));
+    }
+    return valid;
+}
+
+// Joins the threads of the connections that were closed
+void reapConnections()
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    std::list<std::shared_ptr<Connection>>::iterator it = connections.begin();
+    while (it != connections.end()) {
+        if ((*it)->finished) {
+            (*it)->thread.join();  // The thread is about to return, since it sets the flag as its last action
+            it = connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Serves a connection, and closes it once the client closes its end, or once the daemon terminates
+void serveConnection(std::shared_ptr<Connection> connection)
+{
+    handleConnection(connection->fd);
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    close(connection->fd);  // Closed while holding the mutex, so that the descriptor is never shut down by the main thread after being reused
+    connection->finished = true;
+}
+
+// Serves scrapes, one at a time, until the daemon terminates (the listening socket is closed by the main thread)
+void serveMetrics(int listenfd)
+{
+    while (!terminated) {
+        int connfd = accept4(listenfd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connfd >= 0) {
+            handleScrape(connfd);  // Scrapes are answered from memory, so there is no need for a thread per connection
+        }
+    }
+}
+
+// Starts a thread that blocks SIGINT and SIGTERM, so that these signals are always delivered to the main thread, interrupting accept()
+// The thread is joined by the main thread before the daemon exits, so that no thread uses the global variables while they are destroyed
+template <typename Function, typename... Args> std::thread startThread(Function function, Args... args)
+{
+    sigset_t mask, previous;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, &previous);  // The new thread inherits the signal mask of the calling thread
+    std::thread thread(function, args...);
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    return thread;
+}
+
+// Updates the metrics of the given device, which does not need to be locked by the caller (e.g., pollDevices() does not lock it)
+// This relies on the thread safety of ITUSB2Device, whose counters are read without any transfer, while the metrics themselves are protected by "metricsMutex"
+// If "polled" is true, the device is considered up only if "status" is not null
+void updateMetrics(const DeviceEntry &entry, bool polled, const ITUSB2Device::Status *status)
+{
+    ITUSB2Device::Counters counters = entry.device.counters();  // Reading the counters does not require any transfer
+    uint64_t coalesced = entry.worker.coalesced();
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    MetricsEntry &metric = metrics[entry.serial];  // Value initialized (i.e., zeroed) when the device is seen for the first time
+    if (metric.instance != entry.instance) {  // The device was reopened, so the counters of the previous instance are accumulated
+        metric.base.controlTransfers += metric.last.controlTransfers;
+        metric.base.bulkTransfers += metric.last.bulkTransfers;
+        metric.base.transferErrors += metric.last.transferErrors;
+        metric.base.retries += metric.last.retries;
+        metric.base.attachCycles += metric.last.attachCycles;
+        metric.coalescedBase += metric.coalescedLast;
+        metric.instance = entry.instance;
+        metric.disconnected = false;
+    }
+    metric.last = counters;
+    metric.coalescedLast = coalesced;
+    DeviceMetrics &snapshot = metric.snapshot;
+    snapshot.controlTransfers = metric.base.controlTransfers + counters.controlTransfers;
+    snapshot.bulkTransfers = metric.base.bulkTransfers + counters.bulkTransfers;
+    snapshot.transferErrors = metric.base.transferErrors + counters.transferErrors;
+    snapshot.transferRetries = metric.base.retries + counters.retries;
+    snapshot.attachCycles = metric.base.attachCycles + counters.attachCycles;
+    snapshot.coalescedRequests = metric.coalescedBase + coalesced;
+    if (entry.device.disconnected()) {
+        if (!metric.disconnected) {
+            ++snapshot.disconnects;
+            metric.disconnected = true;
+        }
+        snapshot.up = false;
+    } else if (status != nullptr) {
+        if (status->oc && !(snapshot.up && snapshot.status.oc)) {  // Rising edge of the overcurrent flag, as seen between consecutive successful polls
+            ++snapshot.overcurrentTrips;
+        }
+        snapshot.up = true;
+        snapshot.status = *status;
+        snapshot.timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    } else if (polled) {
+        snapshot.up = false;
+    }
+}
@@ -1,4 +1,4 @@
-/* ITUSB2 device class - Version 1.2.1
+/* ITUSB2 device class - Version 1.3.0
    Requires CP2130 class version 1.1.0 or later
    Copyright (c) 2021-2022 Samuel Lourenço
 
@@ -19,27 +19,567 @@
    Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
 
 
+// Since version 1.3.0, a device can be operated from several threads at once, except for open() and close(), which should not overlap any other operation
+// Only the chip select/SPI critical sections (current readings, LTC2312 power management and setup()) are serialized, so that GPIO operations such as switching VBUS never wait for a sampling burst
+
 // Includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 #include "itusb2device.h"
+#include "realtime.h"
 
 // Definitions
 const uint8_t EPIN = 0x82;   // Address of endpoint assuming the IN direction
 const uint8_t EPOUT = 0x01;  // Address of endpoint assuming the OUT direction
 const size_t N_SAMPLES = 5;  // Number of samples per measurement, applicable to getCurrent()
 
+// Specific to the timed waits (added in version 1.3.0)
+const std::chrono::milliseconds SWITCH_DELAY(100);      // Delay after each switching step of attach() and detach() [100ms]
+const std::chrono::microseconds CS_DISABLE_DELAY(100);  // Delay before disabling the chip select after the last reading, in order to prevent possible errors (workaround) [100us]
+
+// Specific to enumerate() (added in version 1.3.0)
+const std::chrono::microseconds ENUM_POLL_MIN(100);    // Shortest polling interval, used right after each switching event [100us]
+const std::chrono::microseconds ENUM_POLL_MAX(10000);  // Longest polling interval [10ms]
+const int ENUM_POLL_RATIO = 32;                        // Ratio between the time elapsed since the last event and the polling interval (the resolution is kept near 3% of the measured time)
+const std::chrono::milliseconds ENUM_DATA_DELAY(100);  // Delay between switching VBUS on and connecting the data lines, as done by attach() [100ms]
+const std::chrono::milliseconds ENUM_TIMEOUT(5000);    // Maximum time to wait for either UDCD or UDHS to assert [5s]
+
+// Specific to the LTC2312 power management (added in version 1.3.0)
+const std::chrono::microseconds ADC_MAX_AGE(1000);   // Maximum age of a conversion for its result to be used, instead of being discarded as a past measurement [1ms]
+const std::chrono::milliseconds ADC_SLEEP_IDLE(100);  // Minimum idle time for which sleep mode is preferred to nap mode, given its much longer wake-up time [100ms]
+const std::chrono::microseconds ADC_WAKE_TIME(1100);  // Time required by the LTC2312 to wake up from sleep mode [1.1ms]
+const int ADC_NAP_PULSES = 2;                         // Number of CONV pulses without SCK activity that put the LTC2312 in nap mode
+const int ADC_SLEEP_PULSES = 4;                       // Number of CONV pulses without SCK activity that put the LTC2312 in sleep mode
+
+// Specific to the current calibration (added in version 1.3.0)
+const char DEFAULT_CALIBRATION[] = "/etc/itusb2/calibration";  // Default calibration file, which can be overridden using the ITUSB2_CALIBRATION environment variable
+const size_t ADC_CODES = 4096;                                 // Number of codes of the LTC2312 (12 bits)
+const int32_t CURRENT_SCALE = 1024;                            // Fixed-point scale of the entries of the current table, per mA (the nominal conversion, code / 4, is exact at this scale)
+
+// Specific to the asynchronous operations (added in version 1.3.0)
+const std::chrono::microseconds SPI_RETRY_DELAY(100);  // Interval between attempts to take the SPI mutex, while it is held by another thread [100us]
+const int SAMPLE_SELECT = 0;                           // Steps of an asynchronous current reading, as done by sampleCurrentAsync()
+const int SAMPLE_WAKE = 1;
+const int SAMPLE_DISCARD = 2;
+const int SAMPLE_READ = 3;
+const int SAMPLE_DESELECT = 4;
+
+// Specific to the retry policy (added in version 1.3.0)
+const std::chrono::milliseconds RETRY_INITIAL_DELAY(1);  // Delay before the first retry of a failed control transfer, when the policy is given by parseRetryPolicy() [1ms]
+const std::chrono::milliseconds RETRY_MAX_DELAY(64);     // Upper bound of the delay between retries, likewise [64ms]
+const uint8_t RETRY_MAX = 16;                            // Maximum number of retries accepted by parseRetryPolicy()
+const std::chrono::milliseconds RECONNECT_POLL(10);      // Interval between attempts to reopen the device, while waiting for it to come back [10ms]
+
+// Fills the table that converts raw codes to currents, in fixed point, according to the given calibration (added in version 1.3.0)
+// This way, calibrated conversions cost the same as nominal ones, which is essential for limitCurrent()
+static void fillCurrentTable(std::vector<int32_t> &table, const ITUSB2Device::Calibration &calibration)
+{
+    const std::vector<std::pair<uint16_t, float>> &points = calibration.points;
+    table.resize(ADC_CODES);
+    size_t segment = 0;  // Index of the first point of the segment used for interpolation (or extrapolation, beyond the first and last points)
+    for (size_t code = 0; code < ADC_CODES; ++code) {
+        double current;
+        if (points.size() < 2) {  // Nominal conversion, shifted so that it passes through the single point, if given
+            current = code / 4.0 + (points.empty() ? 0 : points[0].second - points[0].first / 4.0);
+        } else {
+            while (segment + 2 < points.size() && code > points[segment + 1].first) {
+                ++segment;
+            }
+            const std::pair<uint16_t, float> &first = points[segment], &second = points[segment + 1];
+            current = first.second + (second.second - first.second) * (static_cast<double>(code) - first.first) / (second.first - first.first);
+        }
+        table[code] = static_cast<int32_t>(std::lround((calibration.gain * current + calibration.offset) * CURRENT_SCALE));
+    }
+}
+
+// Parses a floating point number, returning false if the string does not contain exactly one (added in version 1.3.0)
+static bool parseFloat(const char *str, float &value)
+{
+    char *end;
+    value = std::strtof(str, &end);
+    return end != str && *end == '\0';
+}
+
+// Converts the two bytes read from the LTC2312 to a raw code, returning zero if the reading is incomplete (added as a refactor in version 1.3.0)
+static uint16_t rawCurrentCode(const std::vector<uint8_t> &read)
+{
+    return read.size() == 2 ? static_cast<uint16_t>(read[0] << 4 | read[1] >> 4) : 0;  // It is important to check if the size of the returned vector matches the number of expected bytes - If not, return zero!
+}
+
+// Converts a duration to an integer number of microseconds
+static uint32_t toMicroseconds(const std::chrono::steady_clock::duration &duration)
+{
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+// Opens the device at the given location, gets its details and closes it, delivering the result through "promise" (used by listDeviceDetails(), on a separate thread)
+static void queryDetails(const CP2130::DeviceLocation &location, std::shared_ptr<std::promise<ITUSB2Device::DeviceDetails>> promise)
+{
+    ITUSB2Device::DeviceDetails result = {location, false, false, "", "", {0, 0}, 0};
+    ITUSB2Device device;
+    int err = device.openLocation(location);  // The devices were already enumerated by listDeviceDetails()
+    if (err == ITUSB2Device::SUCCESS) {
+        int errcnt = 0;
+        std::string errstr;
+        CP2130::USBConfig config = device.getUSBConfig(errcnt, errstr);
+        result.siliconVersion = device.getCP2130SiliconVersion(errcnt, errstr);
+        result.hardwareRevision = ITUSB2Device::hardwareRevision(config);
+        result.maxPower = static_cast<uint16_t>(2 * config.maxpow);  // The raw value is in 2mA units
+        result.valid = errcnt == 0;
+        if (errcnt > 0) {
+            result.error = device.disconnected() ? "disconnected" : "error";
+        }
+        device.close();
+    } else {
+        result.busy = err == ITUSB2Device::ERROR_BUSY;
+        result.error = err == ITUSB2Device::ERROR_BUSY ? "busy" : (err == ITUSB2Device::ERROR_NOT_FOUND ? "not found" : "error");  // A device can disappear between being listed and being opened
+    }
+    promise->set_value(result);
+}
+
+// Opens the device at the given location, gets its status and closes it, delivering the result through "promise" (used by getAllStatus(), on a separate thread)
+static void queryStatus(const CP2130::DeviceLocation &location, std::shared_ptr<std::promise<ITUSB2Device::DeviceStatus>> promise)
+{
+    ITUSB2Device::DeviceStatus result = {location.serial, false, "", {false, false, false, false, false, 0}};
+    ITUSB2Device device;
+    int err = device.openLocation(location);  // The devices were already enumerated by getAllStatus()
+    if (err == ITUSB2Device::SUCCESS) {
+        int errcnt = 0;
+        std::string errstr;
+        device.setup(errcnt, errstr);  // Prepare the device (SPI setup)
+        result.status = device.getStatus(errcnt, errstr);
+        result.valid = errcnt == 0;
+        if (errcnt > 0) {
+            result.error = device.disconnected() ? "disconnected" : "error";
+        }
+        device.close();
+    } else {
+        result.error = err == ITUSB2Device::ERROR_BUSY ? "busy" : (err == ITUSB2Device::ERROR_NOT_FOUND ? "not found" : "error");  // A device can disappear between being listed and being opened
+    }
+    promise->set_value(result);
+}
+
+// Operation that can be safely repeated, which is repeated once if the device disconnected while it was carried out, and was reconnected (added in version 1.3.0)
+// The errors caused by the disconnection are discarded when the operation is repeated, so that the caller only sees the errors of the repeated operation
+class ITUSB2Device::Attempt
+{
+private:
+    ITUSB2Device &device_;
+    int &errcnt_;
+    std::string &errstr_;
+    int preverrcnt_;
+    size_t preverrlen_;
+    uint64_t prevreconnects_;
+    bool repeated_;
+
+public:
+    Attempt(ITUSB2Device &device, int &errcnt, std::string &errstr);
+
+    bool repeat();
+};
+
+ITUSB2Device::Attempt::Attempt(ITUSB2Device &device, int &errcnt, std::string &errstr) :
+    device_(device),
+    errcnt_(errcnt),
+    errstr_(errstr),
+    preverrcnt_(errcnt),
+    preverrlen_(errstr.size()),
+    prevreconnects_(device.reconnects_),
+    repeated_(false)
+{
+}
+
+// Returns true if the operation failed and should be repeated, reconnecting the device first if required and enabled
+// The device might have been reconnected already by a nested operation (e.g., getCurrent() within getStatus()), in which case the operation is simply repeated
+bool ITUSB2Device::Attempt::repeat()
+{
+    bool retval = false;
+    if (!repeated_ && errcnt_ != preverrcnt_) {
+        repeated_ = true;
+        if (device_.reconnects_ != prevreconnects_) {
+            retval = true;
+        } else if (!device_.reconnecting_ && device_.disconnected() && device_.reconnectTimeout_.count() > 0) {  // Operations carried out by reconnect() itself, such as setup(), never reconnect the device
+            int errcnt = 0;
+            std::string errstr;
+            retval = device_.reconnect(device_.reconnectTimeout_, errcnt, errstr);
+            if (!retval) {
+                errcnt_ += errcnt;
+                errstr_ += errstr;
+            }
+        }
+        if (retval) {
+            errcnt_ = preverrcnt_;
+            errstr_.resize(preverrlen_);
+        }
+    }
+    return retval;
+}
+
+// State of an asynchronous current reading, shared by its steps (added in version 1.3.0)
+struct ITUSB2Device::CurrentSampling {
+    EventLoop *loop;
+    CurrentCompletion completion;
+    int errcnt;
+    std::string errstr;
+    bool fresh;
+    size_t samples;
+    int32_t sum;
+};
+
+// Private function that runs the given asynchronous SPI sequence once every previous one is complete, and the SPI mutex is free (added in version 1.3.0)
+// The SPI mutex can't be waited on by the loop thread, since that would stall every other device - Instead, sequences are queued per device
+// The mutex is always taken by the loop thread, even for the first sequence, since it is released by the loop thread as well (a std::mutex must be unlocked by the thread that owns it)
+void ITUSB2Device::acquireSPIAsync(EventLoop &loop, const std::function<void()> &sequence)
+{
+    {
+        std::lock_guard<std::mutex> lock(spiQueueMutex_);
+        if (spiQueueBusy_) {
+            spiQueue_.push_back(sequence);
+            return;
+        }
+        spiQueueBusy_ = true;
+    }
+    loop.post(std::bind(&ITUSB2Device::lockSPIAsync, this, std::ref(loop), sequence));  // This function is usually called by another thread
+}
+
 // Private convenience function that is used to get the raw current measurement reading from the LTC2312 ADC
 uint16_t ITUSB2Device::getRawCurrent(int &errcnt, std::string &errstr)
 {
     std::vector<uint8_t> read = cp2130_.spiRead(2, EPIN, EPOUT, errcnt, errstr);
-    return read.size() == 2 ? static_cast<uint16_t>(read[0] << 4 | read[1] >> 4) : 0;  // It is important to check if the size of the returned vector matches the number of expected bytes - If not, return zero!
+    lastConversion_ = std::chrono::steady_clock::now();  // The end of each reading starts a new conversion, whose result is returned by the next one
+    return rawCurrentCode(read);
+}
+
+// Private function that loads the calibration data of the device from the calibration file, if it exists (added in version 1.3.0)
+// Important: the SPI mutex should be held, before using this function!
+// Returns true if calibration data was found and applied - Note that the serial number is only read if the file exists, so that no transfer is wasted otherwise
+bool ITUSB2Device::loadCalibration(int &errcnt, std::string &errstr)
+{
+    std::string path = calibrationPath();
+    bool loaded = false;
+    if (!path.empty() && access(path.c_str(), F_OK) == 0) {
+        int preverrcnt = errcnt;
+        std::u16string serialDesc = getSerialDesc(errcnt, errstr);
+        Calibration calibration;
+        if (errcnt == preverrcnt && readCalibration(std::string(serialDesc.begin(), serialDesc.end()), calibration, errcnt, errstr)) {  // Serial numbers are plain ASCII
+            fillCurrentTable(currentTable_, calibration);  // The SPI mutex is already held by setup(), so setCalibration() can't be used here
+            calibrated_ = true;
+            loaded = true;
+        }
+    }
+    return loaded;
+}
+
+// Private function that takes the SPI mutex without blocking, and runs the given sequence, retrying later if the mutex is held by a synchronous operation on another thread (added in version 1.3.0)
+// Important: this function should only be called by the loop thread!
+void ITUSB2Device::lockSPIAsync(EventLoop &loop, const std::function<void()> &sequence)
+{
+    if (spiMutex_.try_lock()) {  // Only one asynchronous sequence gets here at a time, so the mutex is never already owned by the loop thread
+        sequence();
+    } else {
+        loop.at(std::chrono::steady_clock::now() + SPI_RETRY_DELAY, std::bind(&ITUSB2Device::lockSPIAsync, this, std::ref(loop), sequence));
+    }
+}
+
+// Private function that takes a current reading, as done by getCurrent() (added as a refactor in version 1.3.0)
+float ITUSB2Device::measureCurrent(int &errcnt, std::string &errstr)
+{
+    std::lock_guard<std::mutex> lock(spiMutex_);  // Other threads can still switch VBUS or the data lines while the reading is taken
+    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+    if (!wakeADC(errcnt, errstr)) {  // The following is skipped when sampling densely
+        getRawCurrent(errcnt, errstr);  // Discard this reading, as it will reflect a past measurement
+    }
+    int32_t currentSum = 0;
+    for (size_t i = 0; i < N_SAMPLES; ++i) {
+        currentSum += currentTable_[getRawCurrent(errcnt, errstr)];  // Read the raw value (from the LTC2312 on channel 0), convert it using the current table and add it to the sum
+    }
+    waitUntil(std::chrono::steady_clock::now() + CS_DISABLE_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+    return currentSum / (static_cast<double>(CURRENT_SCALE) * N_SAMPLES);  // Return the average current out of "N_SAMPLES" [5] for each measurement (this equals currentCode / 4.0 for a single uncalibrated reading)
+}
+
+// Private function that pulses the chip select of channel 0 (i.e., CONV) the given number of times, without any SCK activity (added in version 1.3.0)
+// Important: the SPI mutex should be held, before using this function!
+void ITUSB2Device::pulseADC(int pulses, int &errcnt, std::string &errstr)
+{
+    for (int i = 0; i < pulses; ++i) {
+        cp2130_.selectCS(0, errcnt, errstr);
+        cp2130_.disableCS(0, errcnt, errstr);
+    }
+}
+
+// Private function that gets the raw current measurement reading from the LTC2312 ADC asynchronously, passing the bytes read to the callback (added in version 1.3.0)
+// Important: the chip select corresponding to channel 0 should be enabled, and the SPI mutex held, before using this function!
+void ITUSB2Device::readRawCurrentAsync(const CP2130::TransferCallback &callback)
+{
+    std::vector<uint8_t> readCommand = {
+        0x00, 0x00,    // Reserved
+        CP2130::READ,  // Read command
+        0x00,          // Reserved
+        0x02, 0x00, 0x00, 0x00  // Two bytes to read
+    };
+    cp2130_.submitBulkTransfer(EPOUT, readCommand, [this, callback](const std::vector<uint8_t> &, int errcnt, const std::string &errstr) {
+        cp2130_.submitBulkTransfer(EPIN, std::vector<uint8_t>(2), [this, callback, errcnt, errstr](const std::vector<uint8_t> &read, int readErrcnt, const std::string &readErrstr) {  // As with spiRead(), the IN transfer is done even if the OUT transfer failed
+            lastConversion_ = std::chrono::steady_clock::now();
+            callback(read, errcnt + readErrcnt, errstr + readErrstr);
+        });
+    });
+}
+
+// Private function that records how late a timed wait woke up (added as a refactor in version 1.3.0)
+void ITUSB2Device::recordSleep(const std::chrono::steady_clock::duration &lateness)
+{
+    int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count();
+    ++sleeps_;
+    sleepLatenessSum_ += nanoseconds;
+    int64_t max = sleepLatenessMax_;
+    while (nanoseconds > max && !sleepLatenessMax_.compare_exchange_weak(max, nanoseconds)) {  // Waits can run concurrently on different threads
+    }
+}
+
+// Private function that releases the SPI mutex at the end of an asynchronous SPI sequence, and starts the next queued one, if any (added in version 1.3.0)
+void ITUSB2Device::releaseSPIAsync(EventLoop &loop)
+{
+    spiMutex_.unlock();
+    std::function<void()> next;
+    {
+        std::lock_guard<std::mutex> lock(spiQueueMutex_);
+        if (spiQueue_.empty()) {
+            spiQueueBusy_ = false;
+            return;
+        }
+        next = spiQueue_.front();
+        spiQueue_.pop_front();
+    }
+    loop.post(std::bind(&ITUSB2Device::lockSPIAsync, this, std::ref(loop), next));  // Posted, so that the completion of the current sequence is not delayed
+}
+
+// Private function that clears the counters kept about a previously open device, before opening another one (added in version 1.3.0)
+// Unlike resetState(), this is not called when the device is reconnected, so that the counters accumulate over the whole time the device is open
+void ITUSB2Device::resetCounters()
+{
+    attachCycles_ = 0;
+    cp2130_.resetCounters();
+    reconnects_ = 0;
+}
+
+// Private function that clears the state kept about a previously open device, before opening another one (added as a refactor in version 1.3.0)
+void ITUSB2Device::resetState()
+{
+    configured_ = false;  // A device that is (re)opened is never assumed to be set up
+    adcState_ = ADC_UNKNOWN;
+    if (calibrated_) {  // The calibration data of the previously open device does not apply
+        fillCurrentTable(currentTable_, {0, 1, {}});
+        calibrated_ = false;
+    }
+}
+
+// Private function that runs the given step of an asynchronous current reading, which follows the same sequence as getCurrent() (added in version 1.3.0)
+// Important: the SPI mutex should be held, before using this function!
+void ITUSB2Device::sampleCurrentAsync(const std::shared_ptr<CurrentSampling> &sampling, int step)
+{
+    if (step == SAMPLE_SELECT) {
+        std::vector<uint8_t> controlBufferOut = {
+            0x00,  // Channel 0
+            0x02   // Only the corresponding chip select is enabled, all the others are disabled
+        };
+        cp2130_.submitControlTransfer(CP2130::SET, CP2130::SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, CP2130::SET_GPIO_CHIP_SELECT_WLEN, [this, sampling](const std::vector<uint8_t> &, int errcnt, const std::string &errstr) {
+            sampling->errcnt += errcnt;
+            sampling->errstr += errstr;
+            sampleCurrentAsync(sampling, SAMPLE_WAKE);
+        });
+    } else if (step == SAMPLE_WAKE) {  // Equivalent to wakeADC()
+        sampling->fresh = adcState_ == ADC_AWAKE && std::chrono::steady_clock::now() - lastConversion_ <= ADC_MAX_AGE;
+        if (adcState_ == ADC_UNKNOWN || adcState_ == ADC_SLEEP) {
+            readRawCurrentAsync([this, sampling](const std::vector<uint8_t> &, int errcnt, const std::string &errstr) {  // Discard this reading - This wakes up the LTC2312, if in nap or sleep mode!
+                sampling->errcnt += errcnt;
+                sampling->errstr += errstr;
+                waitAsync(*sampling->loop, std::chrono::steady_clock::now() + ADC_WAKE_TIME, [this, sampling]() {  // Wait 1.1ms to ensure that the LTC2312 is awake, without blocking the loop
+                    adcState_ = ADC_AWAKE;
+                    sampleCurrentAsync(sampling, SAMPLE_DISCARD);
+                });
+            });
+        } else {
+            adcState_ = ADC_AWAKE;
+            sampleCurrentAsync(sampling, SAMPLE_DISCARD);
+        }
+    } else if (step == SAMPLE_DISCARD) {
+        if (sampling->fresh) {
+            sampleCurrentAsync(sampling, SAMPLE_READ);
+        } else {
+            readRawCurrentAsync([this, sampling](const std::vector<uint8_t> &, int errcnt, const std::string &errstr) {  // Discard this reading, as it will reflect a past measurement
+                sampling->errcnt += errcnt;
+                sampling->errstr += errstr;
+                sampleCurrentAsync(sampling, SAMPLE_READ);
+            });
+        }
+    } else if (step == SAMPLE_READ) {
+        if (sampling->samples < N_SAMPLES) {
+            readRawCurrentAsync([this, sampling](const std::vector<uint8_t> &read, int errcnt, const std::string &errstr) {
+                sampling->errcnt += errcnt;
+                sampling->errstr += errstr;
+                sampling->sum += currentTable_[rawCurrentCode(read)];
+                ++sampling->samples;
+                sampleCurrentAsync(sampling, SAMPLE_READ);
+            });
+        } else {
+            waitAsync(*sampling->loop, std::chrono::steady_clock::now() + CS_DISABLE_DELAY, std::bind(&ITUSB2Device::sampleCurrentAsync, this, sampling, SAMPLE_DESELECT));  // Wait 100us before disabling the chip select (workaround)
+        }
+    } else if (step == SAMPLE_DESELECT) {
+        std::vector<uint8_t> controlBufferOut = {
+            0x00,  // Channel 0
+            0x00   // Corresponding chip select disabled
+        };
+        cp2130_.submitControlTransfer(CP2130::SET, CP2130::SET_GPIO_CHIP_SELECT, 0x0000, 0x0000, controlBufferOut, CP2130::SET_GPIO_CHIP_SELECT_WLEN, [this, sampling](const std::vector<uint8_t> &, int errcnt, const std::string &errstr) {
+            sampling->errcnt += errcnt;
+            sampling->errstr += errstr;
+            releaseSPIAsync(*sampling->loop);
+            sampling->completion(sampling->sum / (static_cast<float>(CURRENT_SCALE) * N_SAMPLES), sampling->errcnt, sampling->errstr);
+        });
+    }
+}
+
+// Private function that sets the values of the given GPIO pins asynchronously, as done by CP2130::setGPIOs() (added in version 1.3.0)
+void ITUSB2Device::setGPIOsAsync(uint16_t values, uint16_t mask, const CP2130::TransferCallback &callback)
+{
+    std::vector<uint8_t> controlBufferOut = {
+        static_cast<uint8_t>((CP2130::BMGPIOS & values) >> 8), static_cast<uint8_t>(CP2130::BMGPIOS & values),  // GPIO values bitmap
+        static_cast<uint8_t>((CP2130::BMGPIOS & mask) >> 8), static_cast<uint8_t>(CP2130::BMGPIOS & mask)       // Mask bitmap
+    };
+    cp2130_.submitControlTransfer(CP2130::SET, CP2130::SET_GPIO_VALUES, 0x0000, 0x0000, controlBufferOut, CP2130::SET_GPIO_VALUES_WLEN, callback);
+}
+
+// Private function that takes the events of the device away from its event loop, if any, so that the loop or the device can be disposed of (added in version 1.3.0)
+void ITUSB2Device::unwatch()
+{
+    EventLoop *loop = loop_.exchange(nullptr);
+    if (loop != nullptr) {
+        loop->unwatch(cp2130_.context());
+    }
+}
+
+// Private function that runs the given task on the event loop once the deadline is reached, recording how late it ran, as waitUntil() does (added in version 1.3.0)
+void ITUSB2Device::waitAsync(EventLoop &loop, const std::chrono::steady_clock::time_point &deadline, const std::function<void()> &task)
+{
+    loop.at(deadline, [this, deadline, task]() {
+        recordSleep(std::chrono::steady_clock::now() - deadline);
+        task();
+    });
+}
+
+// Private function that sleeps until the given deadline, and records how late the wake-up was (added in version 1.3.0)
+// Absolute deadlines are used for all waits, so that the sleep jitter can be reported whether real-time mode is in effect or not
+void ITUSB2Device::waitUntil(const std::chrono::steady_clock::time_point &deadline)
+{
+    recordSleep(sleepUntil(deadline));
+}
+
+// Private function that wakes up the LTC2312 before a burst of readings, if needed (added in version 1.3.0)
+// Returns true if the next reading reflects a recent conversion, or false if it should be discarded
+// Important: the chip select corresponding to channel 0 should be enabled, and the SPI mutex held, before using this function!
+bool ITUSB2Device::wakeADC(int &errcnt, std::string &errstr)
+{
+    bool fresh = adcState_ == ADC_AWAKE && std::chrono::steady_clock::now() - lastConversion_ <= ADC_MAX_AGE;  // Dense sampling only
+    if (adcState_ == ADC_UNKNOWN || adcState_ == ADC_SLEEP) {
+        getRawCurrent(errcnt, errstr);  // Discard this reading - This wakes up the LTC2312, if in nap or sleep mode!
+        waitUntil(std::chrono::steady_clock::now() + ADC_WAKE_TIME);  // Wait 1.1ms to ensure that the LTC2312 is awake
+    }
+    adcState_ = ADC_AWAKE;  // Note that a conversion is always started by the above reading, or by the one that discards a result from nap mode
+    return fresh;
+}
+
+// Private function that hands the events of the device over to the given event loop, before an asynchronous operation is started (added in version 1.3.0)
+// A device should only be used with one event loop at a time - If another loop is given, the device is moved to it
+void ITUSB2Device::watch(EventLoop &loop)
+{
+    EventLoop *previous = loop_.exchange(&loop);
+    if (previous != &loop) {
+        if (previous != nullptr) {
+            previous->unwatch(cp2130_.context());
+        }
+        loop.watch(cp2130_.context());
+    }
+}
+
+// "Equal to" operator for Status (added in version 1.3.0)
+bool ITUSB2Device::Status::operator ==(const ITUSB2Device::Status &other) const
+{
+    return up == other.up && ud == other.ud && cd == other.cd && hs == other.hs && oc == other.oc && current == other.current;
+}
+
+// "Not equal to" operator for Status (added in version 1.3.0)
+bool ITUSB2Device::Status::operator !=(const ITUSB2Device::Status &other) const
+{
+    return !(operator ==(other));
 }
 
 ITUSB2Device::ITUSB2Device() :
-    cp2130_()
+    cp2130_(),
+    spiMutex_(),
+    configured_(false),
+    attachCycles_(0),
+    adcState_(ADC_UNKNOWN),
+    lastConversion_(),
+    currentTable_(),
+    calibrated_(false),
+    sleeps_(0),
+    sleepLatenessSum_(0),
+    sleepLatenessMax_(0),
+    loop_(nullptr),
+    spiQueueMutex_(),
+    spiQueueBusy_(false),
+    spiQueue_(),
+    serial_(),
+    direct_(false),
+    reconnectTimeout_(0),
+    reconnecting_(false),
+    reconnects_(0)
 {
+    fillCurrentTable(currentTable_, {0, 1, {}});  // Nominal conversion
+}
+
+// Added in version 1.3.0
+ITUSB2Device::~ITUSB2Device()
+{
+    close();  // Required so that the LTC2312 is not left in sleep mode (the CP2130 object would close the device on its own, otherwise)
+}
+
+// Returns the power state of the LTC2312, as last known (added in version 1.3.0)
+int ITUSB2Device::adcState() const
+{
+    return adcState_;
+}
+
+// Returns true if calibration data was applied to the current readings (added in version 1.3.0)
+bool ITUSB2Device::calibrated() const
+{
+    return calibrated_;
+}
+
+// Returns the transfer and attachment counters, which can be read at any time without issuing any transfer (added in version 1.3.0)
+ITUSB2Device::Counters ITUSB2Device::counters() const
+{
+    Counters counters;
+    counters.controlTransfers = cp2130_.controlTransfers();
+    counters.bulkTransfers = cp2130_.bulkTransfers();
+    counters.transferErrors = cp2130_.transferErrors();
+    counters.attachCycles = attachCycles_;
+    counters.retries = cp2130_.retries();
+    counters.reconnects = reconnects_;
+    return counters;
 }
 
 // Diagnostic function used to verify if the device has been disconnected
@@ -48,31 +588,127 @@ bool ITUSB2Device::disconnected() const
     return cp2130_.disconnected();
 }
 
+// Checks if the device was successfully set up since it was opened (added in version 1.3.0)
+bool ITUSB2Device::isConfigured() const
+{
+    return configured_;
+}
+
 // Checks if the device is open
 bool ITUSB2Device::isOpen() const
 {
     return cp2130_.isOpen();
 }
 
+// Returns the retry policy in effect (added in version 1.3.0)
+ITUSB2Device::RetryPolicy ITUSB2Device::retryPolicy() const
+{
+    RetryPolicy policy = {cp2130_.retryPolicy(), reconnectTimeout_};
+    return policy;
+}
+
+// Returns the statistics of the lateness of the timed waits, since the device object was created (added in version 1.3.0)
+ITUSB2Device::SleepJitter ITUSB2Device::sleepJitter() const
+{
+    uint64_t sleeps = sleeps_;
+    SleepJitter jitter = {sleeps, sleeps > 0 ? sleepLatenessSum_ / 1000.0 / sleeps : 0, sleepLatenessMax_ / 1000.0};
+    return jitter;
+}
+
+// Returns the number of USB transfers issued since the device was opened (added in version 1.3.0)
+uint64_t ITUSB2Device::transfers() const
+{
+    return cp2130_.transfers();
+}
+
+// Configures the CP2130 event counter to count UDCD rising edges (i.e., DUT connections), and clears it (added in version 1.3.0)
+// UDCD is wired to GPIO.4, which doubles as EVTCNTR, so that connection bounces that are too short to be caught by polling can still be counted
+// Note that GPIO.4 remains an input, and that this setting does not persist across resets
+void ITUSB2Device::armConnectionCounter(int &errcnt, std::string &errstr)
+{
+    CP2130::EventCounter counter = {false, CP2130::PCEVTCNTRRE, 0x0000};
+    cp2130_.setEventCounter(counter, errcnt, errstr);
+}
+
 // Attaches the DUT (device under test) to the HUT (host under test)
 void ITUSB2Device::attach(int &errcnt, std::string &errstr)
 {
     if (getUSBPowerStatus(errcnt, errstr) != getUSBDataStatus(errcnt, errstr)) {  // If true, this condition indicates an unusual state
         switchUSB(false, errcnt, errstr);  // Switch VBUS off and disconnect the data lines
-        usleep(100000);  // Wait 100ms to allow for device shutdown
+        waitUntil(std::chrono::steady_clock::now() + SWITCH_DELAY);  // Wait 100ms to allow for device shutdown
     }
     if (!getUSBPowerStatus(errcnt, errstr) && !getUSBDataStatus(errcnt, errstr)) {  // If both VBUS and data lines are disconnected
         switchUSBPower(true, errcnt, errstr);  // Switch VBUS on
-        usleep(100000);  // Wait 100ms in order to emulate a manual attachment of the device
+        std::chrono::steady_clock::time_point vbusOn = std::chrono::steady_clock::now();  // Since version 1.3.0, both waits are relative to this instant, so that the time taken by the transfers does not add up
+        waitUntil(vbusOn + SWITCH_DELAY);  // Wait 100ms in order to emulate a manual attachment of the device
         switchUSBData(true, errcnt, errstr);  // Connect the data lines
-        usleep(100000);  // Wait 100ms so that device enumeration process can, at least, start (this is not enough to guarantee enumeration, though)
+        waitUntil(vbusOn + 2 * SWITCH_DELAY);  // Wait 100ms so that device enumeration process can, at least, start (this is not enough to guarantee enumeration, though)
+        ++attachCycles_;
     }
 }
 
+// Attaches the DUT asynchronously, following the same sequence as attach(), but using event loop timers instead of sleeping (added in version 1.3.0)
+// Unlike attach(), the sequence is interrupted as soon as a transfer fails
+void ITUSB2Device::attachAsync(EventLoop &loop, const Completion &completion)
+{
+    EventLoop *eventLoop = &loop;
+    std::function<void()> powerUp = [this, eventLoop, completion]() {
+        switchUSBPowerAsync(*eventLoop, true, [this, eventLoop, completion](int errcnt, const std::string &errstr) {  // Switch VBUS on
+            if (errcnt > 0) {
+                completion(errcnt, errstr);
+            } else {
+                std::chrono::steady_clock::time_point vbusOn = std::chrono::steady_clock::now();  // Both waits are relative to this instant, as in attach()
+                waitAsync(*eventLoop, vbusOn + SWITCH_DELAY, [this, eventLoop, completion, vbusOn]() {  // Wait 100ms in order to emulate a manual attachment of the device
+                    switchUSBDataAsync(*eventLoop, true, [this, eventLoop, completion, vbusOn](int errcnt, const std::string &errstr) {  // Connect the data lines
+                        if (errcnt > 0) {
+                            completion(errcnt, errstr);
+                        } else {
+                            waitAsync(*eventLoop, vbusOn + 2 * SWITCH_DELAY, [this, completion]() {  // Wait 100ms so that device enumeration process can, at least, start
+                                ++attachCycles_;
+                                completion(0, std::string());
+                            });
+                        }
+                    });
+                });
+            }
+        });
+    };
+    getSignalsAsync(loop, [this, eventLoop, completion, powerUp](uint16_t signals, int errcnt, const std::string &errstr) {
+        bool up = (signals & SIGNAL_UPEN) == 0, ud = (signals & SIGNAL_UDEN) == 0;  // Both signals are active low
+        if (errcnt > 0) {
+            completion(errcnt, errstr);
+        } else if (up != ud) {  // If true, this condition indicates an unusual state
+            switchUSBAsync(*eventLoop, false, [this, eventLoop, completion, powerUp](int errcnt, const std::string &errstr) {  // Switch VBUS off and disconnect the data lines
+                if (errcnt > 0) {
+                    completion(errcnt, errstr);
+                } else {
+                    waitAsync(*eventLoop, std::chrono::steady_clock::now() + SWITCH_DELAY, powerUp);  // Wait 100ms to allow for device shutdown
+                }
+            });
+        } else if (!up) {  // If both VBUS and data lines are disconnected
+            powerUp();
+        } else {
+            completion(0, std::string());
+        }
+    });
+}
+
 // Closes the device safely, if open
+// Since version 1.3.0, the LTC2312 is woken up if it was put in sleep mode, so that the next run does not need to assume so
+// Important: asynchronous operations should be complete before closing the device
 void ITUSB2Device::close()
 {
+    unwatch();  // The event loop must stop handling the events of the device before its context is freed
+    std::lock_guard<std::mutex> lock(spiMutex_);
+    if (isOpen() && !disconnected() && adcState_ == ADC_SLEEP) {
+        int errcnt = 0;
+        std::string errstr;
+        cp2130_.selectCS(0, errcnt, errstr);
+        getRawCurrent(errcnt, errstr);  // This wakes up the LTC2312, which then settles on its own
+        cp2130_.disableCS(0, errcnt, errstr);
+    }
     cp2130_.close();
+    configured_ = false;
 }
 
 // Detaches the DUT (device under test) to the HUT (host under test)
@@ -80,12 +716,108 @@ void ITUSB2Device::detach(int &errcnt, std::string &errstr)
 {
     if (getUSBDataStatus(errcnt, errstr)) {  // If the data lines are connected
         switchUSBData(false, errcnt, errstr);  // Disconnect the data lines
-        usleep(100000);  // Wait 100ms in order to emulate a manual detachment of the device
+        waitUntil(std::chrono::steady_clock::now() + SWITCH_DELAY);  // Wait 100ms in order to emulate a manual detachment of the device
     }
     if (getUSBPowerStatus(errcnt, errstr)) {  // If VBUS is switched on
         switchUSBPower(false, errcnt, errstr);  // Switch VBUS off
-        usleep(100000);  // Wait 100ms to allow for device shutdown
+        waitUntil(std::chrono::steady_clock::now() + SWITCH_DELAY);  // Wait 100ms to allow for device shutdown
+    }
+}
+
+// Detaches the DUT asynchronously, following the same sequence as detach(), but using event loop timers instead of sleeping (added in version 1.3.0)
+// Unlike detach(), the sequence is interrupted as soon as a transfer fails
+void ITUSB2Device::detachAsync(EventLoop &loop, const Completion &completion)
+{
+    EventLoop *eventLoop = &loop;
+    std::function<void()> powerDown = [this, eventLoop, completion]() {
+        getSignalsAsync(*eventLoop, [this, eventLoop, completion](uint16_t signals, int errcnt, const std::string &errstr) {
+            if (errcnt > 0) {
+                completion(errcnt, errstr);
+            } else if ((signals & SIGNAL_UPEN) == 0) {  // If VBUS is switched on
+                switchUSBPowerAsync(*eventLoop, false, [this, eventLoop, completion](int errcnt, const std::string &errstr) {  // Switch VBUS off
+                    if (errcnt > 0) {
+                        completion(errcnt, errstr);
+                    } else {
+                        waitAsync(*eventLoop, std::chrono::steady_clock::now() + SWITCH_DELAY, std::bind(completion, 0, std::string()));  // Wait 100ms to allow for device shutdown
+                    }
+                });
+            } else {
+                completion(0, std::string());
+            }
+        });
+    };
+    getSignalsAsync(loop, [this, eventLoop, completion, powerDown](uint16_t signals, int errcnt, const std::string &errstr) {
+        if (errcnt > 0) {
+            completion(errcnt, errstr);
+        } else if ((signals & SIGNAL_UDEN) == 0) {  // If the data lines are connected
+            switchUSBDataAsync(*eventLoop, false, [this, eventLoop, completion, powerDown](int errcnt, const std::string &errstr) {  // Disconnect the data lines
+                if (errcnt > 0) {
+                    completion(errcnt, errstr);
+                } else {
+                    waitAsync(*eventLoop, std::chrono::steady_clock::now() + SWITCH_DELAY, powerDown);  // Wait 100ms in order to emulate a manual detachment of the device
+                }
+            });
+        } else {
+            powerDown();
+        }
+    });
+}
+
+// Detaches and reattaches the DUT, while measuring the time it takes to connect (UDCD) and to link at high speed (UDHS)
+// Polling starts every 100us right after each event, and backs off as time passes (up to 10ms), so that early events are timed with sub-millisecond resolution
+ITUSB2Device::EnumTiming ITUSB2Device::enumerate(int &errcnt, std::string &errstr)
+{
+    EnumTiming timing = {false, false, 0, 0, 0, 0, 0, false};
+    detach(errcnt, errstr);  // Detach DUT from HUT (VBUS off and data lines disconnected)
+    armConnectionCounter(errcnt, errstr);  // Count every connection from now on, including bounces (added in version 1.3.0)
+    switchUSBPower(true, errcnt, errstr);  // Switch VBUS on
+    std::chrono::steady_clock::time_point vbusOn = std::chrono::steady_clock::now();  // All timings are based on the monotonic clock
+    std::chrono::steady_clock::time_point phaseStart = vbusOn, previous = vbusOn, cdTime;
+    bool dataOn = false;
+    while (errcnt == 0) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!dataOn && now - vbusOn >= ENUM_DATA_DELAY) {  // Connect the data lines 100ms after VBUS, in order to emulate a manual attachment of the device
+            switchUSBData(true, errcnt, errstr);
+            dataOn = true;
+            ++attachCycles_;
+            phaseStart = std::chrono::steady_clock::now();  // Poll finely again, since the DUT is most likely to connect right after this event
+        }
+        uint16_t gpios = cp2130_.getGPIOs(errcnt, errstr);  // Both UDCD and UDHS are obtained from a single transfer
+        std::chrono::steady_clock::time_point sample = std::chrono::steady_clock::now();
+        if (!timing.cd && (CP2130::BMGPIO4 & gpios) != 0x0000) {  // UDCD asserted
+            timing.cd = true;
+            timing.cdLatency = toMicroseconds(sample - vbusOn);
+            timing.cdResolution = toMicroseconds(sample - previous);
+            cdTime = sample;
+            phaseStart = sample;
+        }
+        if (timing.cd && dataOn && (CP2130::BMGPIO5 & gpios) != 0x0000) {  // UDHS asserted (only meaningful after UDCD, with the data lines connected)
+            timing.hs = true;
+            timing.hsLatency = toMicroseconds(sample - cdTime);
+            timing.hsResolution = cdTime == sample ? timing.cdResolution : toMicroseconds(sample - (previous > cdTime ? previous : cdTime));
+            break;
+        }
+        if (dataOn && sample - phaseStart >= ENUM_TIMEOUT) {  // Give up after 5 seconds without UDCD (after connecting the data lines) or without UDHS (after UDCD)
+            break;
+        }
+        previous = sample;
+        std::chrono::steady_clock::duration sleep = (sample - phaseStart) / ENUM_POLL_RATIO;
+        if (sleep < ENUM_POLL_MIN) {
+            sleep = ENUM_POLL_MIN;
+        } else if (sleep > ENUM_POLL_MAX) {
+            sleep = ENUM_POLL_MAX;
+        }
+        if (!dataOn && vbusOn + ENUM_DATA_DELAY - sample < sleep) {  // Do not oversleep the instant when the data lines should be connected
+            sleep = vbusOn + ENUM_DATA_DELAY - sample;
+        }
+        if (sleep > std::chrono::steady_clock::duration::zero()) {
+            waitUntil(sample + sleep);  // The deadline is relative to the sample, so that the time taken by this iteration is not added to the polling interval
+        }
     }
+    CP2130::EventCounter counter = getConnectionCounter(errcnt, errstr);
+    timing.cdEdges = counter.value;
+    timing.cdOverflow = counter.overflow;
+    return timing;
 }
 
 // Returns the silicon version of the CP2130 bridge
@@ -94,31 +826,60 @@ CP2130::SiliconVersion ITUSB2Device::getCP2130SiliconVersion(int &errcnt, std::s
     return cp2130_.getSiliconVersion(errcnt, errstr);
 }
 
+// Gets the number of UDCD rising edges counted since armConnectionCounter() was called, along with the overflow flag (added in version 1.3.0)
+CP2130::EventCounter ITUSB2Device::getConnectionCounter(int &errcnt, std::string &errstr)
+{
+    return cp2130_.getEventCounter(errcnt, errstr);
+}
+
 // Gets the VBUS current
 // Important: SPI mode should be configured for channel 0, before using this function!
 float ITUSB2Device::getCurrent(int &errcnt, std::string &errstr)
 {
-    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-    getRawCurrent(errcnt, errstr);  // Discard this reading, as it will reflect a past measurement
-    size_t currentCodeSum = 0;
-    for (size_t i = 0; i < N_SAMPLES; ++i) {
-        currentCodeSum += getRawCurrent(errcnt, errstr);  // Read the raw value (from the LTC2312 on channel 0) and add it to the sum
-    }
-    usleep(100);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
-    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
-    return currentCodeSum / (4.0 * N_SAMPLES);  // Return the average current out of "N_SAMPLES" [5] for each measurement (currentCode / 4.0 for a single reading)
+    Attempt attempt(*this, errcnt, errstr);
+    float current;
+    do {
+        current = measureCurrent(errcnt, errstr);
+    } while (attempt.repeat());
+    return current;
+}
+
+// Gets the VBUS current asynchronously (added in version 1.3.0)
+// The reading waits for any other reading of the same device to complete, but never blocks the event loop
+// Important: SPI mode should be configured for channel 0, before using this function!
+void ITUSB2Device::getCurrentAsync(EventLoop &loop, const CurrentCompletion &completion)
+{
+    watch(loop);
+    std::shared_ptr<CurrentSampling> sampling = std::make_shared<CurrentSampling>();
+    sampling->loop = &loop;
+    sampling->completion = completion;
+    sampling->errcnt = 0;
+    sampling->fresh = false;
+    sampling->samples = 0;
+    sampling->sum = 0;
+    acquireSPIAsync(loop, std::bind(&ITUSB2Device::sampleCurrentAsync, this, sampling, SAMPLE_SELECT));
 }
 
 // Gets the DUT connection status (true for connection detected or false for connection not detected)
 bool ITUSB2Device::getDUTConnectionStatus(int &errcnt, std::string &errstr)
 {
-    return cp2130_.getGPIO4(errcnt, errstr);  // Return the current state of the UDCD signal
+    Attempt attempt(*this, errcnt, errstr);
+    bool value;
+    do {
+        value = cp2130_.getGPIO4(errcnt, errstr);  // Return the current state of the UDCD signal
+    } while (attempt.repeat());
+    return value;
 }
 
 // Gets the DUT link speed status (true for high-speed, or false for full/low speed or suspend mode)
 bool ITUSB2Device::getDUTSpeedStatus(int &errcnt, std::string &errstr)
 {
-    return cp2130_.getGPIO5(errcnt, errstr);  // Return the current state of the UDHS signal
+    Attempt attempt(*this, errcnt, errstr);
+    bool value;
+    do {
+        value = cp2130_.getGPIO5(errcnt, errstr);  // Return the current state of the UDHS signal
+    } while (attempt.repeat());
+    return value;
 }
 
 // Returns the hardware revision of the device
@@ -136,7 +897,12 @@ std::u16string ITUSB2Device::getManufacturerDesc(int &errcnt, std::string &errst
 // Gets OC flag
 bool ITUSB2Device::getOvercurrentStatus(int &errcnt, std::string &errstr)
 {
-    return !cp2130_.getGPIO3(errcnt, errstr);  // Return the current state of the negated !UDOC signal
+    Attempt attempt(*this, errcnt, errstr);
+    bool value;
+    do {
+        value = !cp2130_.getGPIO3(errcnt, errstr);  // Return the current state of the negated !UDOC signal
+    } while (attempt.repeat());
+    return value;
 }
 
 // Gets the product descriptor from the device
@@ -151,6 +917,65 @@ std::u16string ITUSB2Device::getSerialDesc(int &errcnt, std::string &errstr)
     return cp2130_.getSerialDesc(errcnt, errstr);
 }
 
+// Gets the raw state of the !UPEN, !UDEN, !UDOC, UDCD and UDHS signals, from a single GPIO snapshot (added in version 1.3.0)
+uint16_t ITUSB2Device::getSignals(int &errcnt, std::string &errstr)
+{
+    Attempt attempt(*this, errcnt, errstr);
+    uint16_t signals;
+    do {
+        signals = cp2130_.getGPIOs(errcnt, errstr) & SIGNALS;
+    } while (attempt.repeat());
+    return signals;
+}
+
+// Gets the raw state of the signals asynchronously, as done by getSignals() (added in version 1.3.0)
+void ITUSB2Device::getSignalsAsync(EventLoop &loop, const SignalsCompletion &completion)
+{
+    watch(loop);
+    cp2130_.submitControlTransfer(CP2130::GET, CP2130::GET_GPIO_VALUES, 0x0000, 0x0000, std::vector<uint8_t>(), CP2130::GET_GPIO_VALUES_WLEN, [completion](const std::vector<uint8_t> &data, int errcnt, const std::string &errstr) {
+        uint16_t gpios = data.size() == CP2130::GET_GPIO_VALUES_WLEN ? static_cast<uint16_t>(CP2130::BMGPIOS & (data[0] << 8 | data[1])) : 0x0000;  // Big-endian conversion
+        completion(gpios & SIGNALS, errcnt, errstr);
+    });
+}
+
+// Gets the complete status of the device, using a single transfer to obtain all the status signals, followed by a current measurement (added in version 1.3.0)
+// Important: SPI mode should be configured for channel 0, before using this function!
+ITUSB2Device::Status ITUSB2Device::getStatus(int &errcnt, std::string &errstr)
+{
+    Attempt attempt(*this, errcnt, errstr);
+    Status status;
+    do {
+        uint16_t gpios = cp2130_.getGPIOs(errcnt, errstr);  // This is equivalent to calling getUSBPowerStatus(), getUSBDataStatus(), getDUTConnectionStatus(), getDUTSpeedStatus() and getOvercurrentStatus(), but with one transfer instead of five
+        status.up = (CP2130::BMGPIO1 & gpios) == 0x0000;  // Negated !UPEN signal
+        status.ud = (CP2130::BMGPIO2 & gpios) == 0x0000;  // Negated !UDEN signal
+        status.oc = (CP2130::BMGPIO3 & gpios) == 0x0000;  // Negated !UDOC signal
+        status.cd = (CP2130::BMGPIO4 & gpios) != 0x0000;  // UDCD signal
+        status.hs = (CP2130::BMGPIO5 & gpios) != 0x0000;  // UDHS signal
+        status.current = getCurrent(errcnt, errstr);
+    } while (attempt.repeat());
+    return status;
+}
+
+// Gets the complete status of the device asynchronously, as done by getStatus() (added in version 1.3.0)
+// Important: SPI mode should be configured for channel 0, before using this function!
+void ITUSB2Device::getStatusAsync(EventLoop &loop, const StatusCompletion &completion)
+{
+    EventLoop *eventLoop = &loop;
+    getSignalsAsync(loop, [this, eventLoop, completion](uint16_t signals, int errcnt, const std::string &errstr) {
+        Status status;
+        status.up = (SIGNAL_UPEN & signals) == 0x0000;  // Negated !UPEN signal
+        status.ud = (SIGNAL_UDEN & signals) == 0x0000;  // Negated !UDEN signal
+        status.oc = (SIGNAL_UDOC & signals) == 0x0000;  // Negated !UDOC signal
+        status.cd = (SIGNAL_UDCD & signals) != 0x0000;  // UDCD signal
+        status.hs = (SIGNAL_UDHS & signals) != 0x0000;  // UDHS signal
+        getCurrentAsync(*eventLoop, [completion, status, errcnt, errstr](float current, int currentErrcnt, const std::string &currentErrstr) {
+            Status result = status;
+            result.current = current;
+            completion(result, errcnt + currentErrcnt, errstr + currentErrstr);
+        });
+    });
+}
+
 // Gets the USB configuration of the device
 CP2130::USBConfig ITUSB2Device::getUSBConfig(int &errcnt, std::string &errstr)
 {
@@ -160,60 +985,372 @@ CP2130::USBConfig ITUSB2Device::getUSBConfig(int &errcnt, std::string &errstr)
 // Gets the status of the data lines
 bool ITUSB2Device::getUSBDataStatus(int &errcnt, std::string &errstr)
 {
-    return !cp2130_.getGPIO2(errcnt, errstr);  // Return the current state of the negated !UDEN signal
+    Attempt attempt(*this, errcnt, errstr);
+    bool value;
+    do {
+        value = !cp2130_.getGPIO2(errcnt, errstr);  // Return the current state of the negated !UDEN signal
+    } while (attempt.repeat());
+    return value;
 }
 
 // Gets the status of VBUS
 bool ITUSB2Device::getUSBPowerStatus(int &errcnt, std::string &errstr)
 {
-    return !cp2130_.getGPIO1(errcnt, errstr);  // Return the current state of the negated !UPEN signal
+    Attempt attempt(*this, errcnt, errstr);
+    bool value;
+    do {
+        value = !cp2130_.getGPIO1(errcnt, errstr);  // Return the current state of the negated !UPEN signal
+    } while (attempt.repeat());
+    return value;
+}
+
+// Puts the LTC2312 in the power saving mode that best suits the expected idle time, given the respective wake-up costs (added in version 1.3.0)
+// Nothing is done for very short idle times, so that dense sampling does not waste conversions
+void ITUSB2Device::idleADC(const std::chrono::microseconds &idle, int &errcnt, std::string &errstr)
+{
+    if (idle >= ADC_SLEEP_IDLE) {
+        sleepADC(errcnt, errstr);  // The 1.1ms wake-up time is negligible in comparison
+    } else if (idle > ADC_MAX_AGE) {
+        napADC(errcnt, errstr);  // The first reading after the idle time would be discarded anyway
+    }
+}
+
+// Monitors the VBUS current continuously, switching VBUS off (and the data lines, if so configured) as soon as the given limits are exceeded, or until "stop" is set
+// Single readings are taken while keeping the chip select enabled, so that each sample costs only two bulk transfers, hence minimizing the reaction time
+// Important: SPI mode should be configured for channel 0, before using this function!
+ITUSB2Device::CurrentTrip ITUSB2Device::limitCurrent(const CurrentLimit &limit, const std::atomic<bool> &stop, int &errcnt, std::string &errstr)
+{
+    CurrentTrip trip = {false, false, 0, 0, 0, 0, 0, 0};
+    std::lock_guard<std::mutex> lock(spiMutex_);  // Readings by other threads wait until monitoring stops
+    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+    if (!wakeADC(errcnt, errstr)) {
+        getRawCurrent(errcnt, errstr);  // Discard this reading, as it will reflect a past measurement
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), previous = start;
+    double i2t = 0;  // Consumed I2t budget, in mA^2*s
+    double rating2 = static_cast<double>(limit.rating) * limit.rating;
+    while (!stop && errcnt == 0) {
+        float current = static_cast<float>(currentTable_[getRawCurrent(errcnt, errstr)]) / CURRENT_SCALE;  // Single reading (currentCode / 4.0, if uncalibrated)
+        std::chrono::steady_clock::time_point sample = std::chrono::steady_clock::now();
+        if (errcnt > 0) {
+            break;
+        }
+        ++trip.samples;
+        uint32_t period = toMicroseconds(sample - previous);
+        trip.maxPeriod = period > trip.maxPeriod ? period : trip.maxPeriod;
+        if (limit.budget > 0) {
+            i2t += (static_cast<double>(current) * current - rating2) * period / 1000000.0;
+            i2t = i2t < 0 ? 0 : i2t;  // The budget is fully replenished, but never more than that
+        }
+        if ((limit.threshold > 0 && current > limit.threshold) || (limit.budget > 0 && i2t > limit.budget)) {
+            if (limit.data) {  // The lines are switched directly, instead of via switchUSB() or switchUSBPower(), which could reconnect the device, and therefore deadlock while the SPI mutex is held
+                cp2130_.setGPIOs(CP2130::BMGPIOS, CP2130::BMGPIO1 | CP2130::BMGPIO2, errcnt, errstr);  // Switch VBUS off and disconnect the data lines (both signals are active low)
+            } else {
+                cp2130_.setGPIO1(true, errcnt, errstr);  // Switch VBUS off (GPIO.1 corresponds to the !UPEN signal)
+            }
+            std::chrono::steady_clock::time_point off = std::chrono::steady_clock::now();
+            trip.tripped = true;
+            trip.i2t = !(limit.threshold > 0 && current > limit.threshold);
+            trip.current = current;
+            trip.time = std::chrono::duration_cast<std::chrono::microseconds>(sample - start).count();
+            trip.detection = period;
+            trip.switching = toMicroseconds(off - sample);
+            break;
+        }
+        previous = sample;
+    }
+    waitUntil(std::chrono::steady_clock::now() + CS_DISABLE_DELAY);  // Wait 100us, in order to prevent possible errors while disabling the chip select (workaround)
+    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+    return trip;
+}
+
+// Puts the LTC2312 in nap mode, until the next reading (added in version 1.3.0)
+void ITUSB2Device::napADC(int &errcnt, std::string &errstr)
+{
+    std::lock_guard<std::mutex> lock(spiMutex_);
+    if (adcState_ != ADC_NAP && adcState_ != ADC_SLEEP) {
+        pulseADC(ADC_NAP_PULSES, errcnt, errstr);
+        adcState_ = ADC_NAP;
+    }
 }
 
 // Opens a device and assigns its handle
 // The serial number is optional since version 1.2.0
 int ITUSB2Device::open(const std::string &serial)
 {
+    if (!isOpen()) {
+        resetState();
+        resetCounters();
+        serial_ = serial;
+        direct_ = false;
+    }
     return cp2130_.open(VID, PID, serial);
 }
 
+// Opens a device without enumerating the USB devices on the host, and assigns its handle (added in version 1.3.0)
+// If the ITUSB2_FD environment variable is set, the device is opened via the usbfs file descriptor it specifies, which is expected to be inherited from a launcher - Otherwise, the device node is located via sysfs
+// This is meant for processes that operate a single device, since older versions of libusb disable device discovery for the whole process (see CP2130::openDirect())
+int ITUSB2Device::openDirect(const std::string &serial)
+{
+    if (!isOpen()) {
+        resetState();
+        resetCounters();
+        serial_ = serial;
+        direct_ = true;
+    }
+    int retval;
+    const char *env = std::getenv("ITUSB2_FD");
+    if (env != nullptr && *env != '\0') {
+        char *end;
+        long fd = std::strtol(env, &end, 10);
+        if (*end != '\0' || fd < 0 || fd > INT_MAX) {  // An invalid file descriptor is reported as if the device was not found
+            retval = ERROR_NOT_FOUND;
+        } else {
+            retval = cp2130_.openFD(static_cast<int>(fd), VID, PID, serial);
+        }
+    } else {
+        retval = cp2130_.openDirect(VID, PID, serial);
+    }
+    return retval;
+}
+
+// Opens the device at the given location, as obtained from locateDevices(), without enumerating the USB devices on the host again (added in version 1.3.0)
+// If reconnected, the device is found by the serial number given by the location
+int ITUSB2Device::openLocation(const CP2130::DeviceLocation &location)
+{
+    if (!isOpen()) {
+        resetState();
+        resetCounters();
+        serial_ = location.serial;
+        direct_ = false;
+    }
+    return cp2130_.openLocation(location, VID, PID);
+}
+
+// Reopens the device after it disconnected, waiting up to the given time for it to come back, and sets it up again if it was set up before (added in version 1.3.0)
+// The device is found by the serial number given when it was opened, and reopened in the same way - Returns true if successful
+// Important: no other thread should operate the device while it is reconnected!
+bool ITUSB2Device::reconnect(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr)
+{
+    bool configured = configured_;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    bool retval = false;
+    bool retry = true;
+    reconnecting_ = true;
+    while (retry) {
+        close();
+        resetState();
+        int err = direct_ ? cp2130_.openDirect(VID, PID, serial_) : cp2130_.open(VID, PID, serial_);  // Note that a device opened via ITUSB2_FD is reopened via its device node, since the inherited file descriptor refers to a device that is gone
+        int preverrcnt = errcnt;
+        size_t preverrlen = errstr.size();
+        if (err == SUCCESS && configured) {
+            setup(errcnt, errstr);
+        }
+        retval = err == SUCCESS && errcnt == preverrcnt;
+        bool gone = err == ERROR_NOT_FOUND || (err == SUCCESS && disconnected());  // The device is still re-enumerating, or went away again while being set up
+        retry = !retval && gone && std::chrono::steady_clock::now() < deadline;
+        if (retry) {
+            errcnt = preverrcnt;
+            errstr.resize(preverrlen);
+            std::this_thread::sleep_for(RECONNECT_POLL);
+        } else if (err != SUCCESS) {
+            ++errcnt;
+            errstr += "In reconnect(): could not reopen the device.\n";
+        }
+    }
+    reconnecting_ = false;
+    if (retval) {
+        ++reconnects_;
+    }
+    return retval;
+}
+
 // Issues a reset to the CP2130, which in effect resets the entire device
 void ITUSB2Device::reset(int &errcnt, std::string &errstr)
 {
     cp2130_.reset(errcnt, errstr);
 }
 
-// Sets up and prepares the device
-void ITUSB2Device::setup(int &errcnt, std::string &errstr)
+// Issues a reset to the CP2130, waits for the device to re-enumerate and reopens it, returning the time taken to leave the bus and to become ready again (added in version 1.3.0)
+// The device comes back with the USB power and data lines disconnected - If it was set up before, it is set up again, and the time taken to do so is included in the "ready" time
+// Important: no other thread should operate the device while it is reset!
+CP2130::ResetTiming ITUSB2Device::resetAndReopen(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr)
 {
-    CP2130::SPIMode mode;
-    mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 0 is push-pull
-    mode.cfrq = CP2130::CFRQ1500K;  // SPI clock frequency set to 1.5MHz
-    mode.cpol = CP2130::CPOL0;  // SPI clock polarity is active high (CPOL = 0)
-    mode.cpha = CP2130::CPHA0;  // SPI data is valid on each rising edge (CPHA = 0)
-    cp2130_.configureSPIMode(0, mode, errcnt, errstr);  // Configure SPI mode for channel 0, using the above settings
-    cp2130_.disableSPIDelays(0, errcnt, errstr);  // Disable all SPI delays for channel 0
-    cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
-    getRawCurrent(errcnt, errstr);  // Discard this first reading - This also wakes up the LTC2312, if in nap or sleep mode!
-    usleep(1100);  // Wait 1.1ms to ensure that the LTC2312 is awake, and also to prevent possible errors while disabling the chip select (workaround)
-    cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+    bool configured = configured_;
+    CP2130::ResetTiming timing = cp2130_.resetAndReopen(timeout, errcnt, errstr);
+    if (timing.ready != 0) {  // The device was reopened, and is now in its power-on state (unlike resetState(), the calibration data is kept, since this is the same device)
+        configured_ = false;
+        adcState_ = ADC_UNKNOWN;
+        if (configured) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            setup(errcnt, errstr);
+            timing.ready += toMicroseconds(std::chrono::steady_clock::now() - start);
+        }
+    }
+    return timing;
+}
+
+// Applies the given calibration data to the current readings (added in version 1.3.0)
+// The points of the table, if any, should be sorted by code, and have distinct codes
+void ITUSB2Device::setCalibration(const Calibration &calibration)
+{
+    std::lock_guard<std::mutex> lock(spiMutex_);
+    fillCurrentTable(currentTable_, calibration);
+    calibrated_ = true;
+}
+
+// Sets the policy according to which failed transfers are retried, and the device is reconnected (added in version 1.3.0)
+// If automatic reconnection is enabled, an operation that gets the status or switches the lines, and that fails because the device disconnected, reconnects the device and is then repeated once (see reconnect())
+// If the device was opened without a serial number, its serial number is read, so that the same device is found when reconnecting
+// Important: automatic reconnection should not be enabled if the device is operated by more than one thread!
+void ITUSB2Device::setRetryPolicy(const RetryPolicy &policy, int &errcnt, std::string &errstr)
+{
+    cp2130_.setRetryPolicy(policy.transfers);
+    reconnectTimeout_ = policy.reconnect;
+    if (policy.reconnect.count() > 0 && serial_.empty() && isOpen()) {
+        std::u16string serial = cp2130_.getSerialDesc(errcnt, errstr);
+        serial_.assign(serial.begin(), serial.end());  // Serial numbers are plain ASCII
+    }
+}
+
+// Sets up and prepares the device, returning a report of the steps that were skipped
+// The SPI configuration of channel 0 is read back first, and only written if it differs from the expected one (fast path added in version 1.3.0)
+// If the configuration was already applied, the device was set up by a previous run, and the LTC2312 wake-up sequence is skipped as well
+// In that case, the power state of the LTC2312 is left unknown, unless already known, since a previous process may have left it in sleep mode (e.g., if it was killed) - The first reading then wakes it up, as wakeADC() does
+ITUSB2Device::SetupReport ITUSB2Device::setup(int &errcnt, std::string &errstr)
+{
+    Attempt attempt(*this, errcnt, errstr);
+    SetupReport report;
+    do {
+        int preverrcnt = errcnt;
+        report = {false, false, false, false};
+        std::lock_guard<std::mutex> lock(spiMutex_);
+        CP2130::SPIMode mode;
+        mode.csmode = CP2130::CSMODEPP;  // Chip select pin mode regarding channel 0 is push-pull
+        mode.cfrq = CP2130::CFRQ1500K;  // SPI clock frequency set to 1.5MHz
+        mode.cpol = CP2130::CPOL0;  // SPI clock polarity is active high (CPOL = 0)
+        mode.cpha = CP2130::CPHA0;  // SPI data is valid on each rising edge (CPHA = 0)
+        CP2130::SPIDelays delays = {false, false, false, false, 0x0000, 0x0000, 0x0000};  // All SPI delays disabled, no CS toggle
+        report.modeSkipped = cp2130_.getSPIMode(0, errcnt, errstr) == mode && errcnt == preverrcnt;
+        report.delaysSkipped = cp2130_.getSPIDelays(0, errcnt, errstr) == delays && errcnt == preverrcnt;
+        report.wakeupSkipped = report.modeSkipped && report.delaysSkipped;
+        if (errcnt == preverrcnt && !report.wakeupSkipped) {  // If the read back failed, the device is most likely disconnected, so there is no point in going any further
+            if (!report.modeSkipped) {
+                cp2130_.configureSPIMode(0, mode, errcnt, errstr);  // Configure SPI mode for channel 0, using the above settings
+            }
+            if (!report.delaysSkipped) {
+                cp2130_.disableSPIDelays(0, errcnt, errstr);  // Disable all SPI delays for channel 0
+            }
+            cp2130_.selectCS(0, errcnt, errstr);  // Enable the chip select corresponding to channel 0, and disable any others
+            adcState_ = ADC_UNKNOWN;
+            wakeADC(errcnt, errstr);  // Also waits 1.1ms, which prevents possible errors while disabling the chip select (workaround)
+            cp2130_.disableCS(0, errcnt, errstr);  // Disable the previously enabled chip select
+        }
+        if (errcnt == preverrcnt && !calibrated_) {
+            loadCalibration(errcnt, errstr);  // Since version 1.3.0, calibration data is applied, if available for this device
+        }
+        report.calibrated = calibrated_;
+        configured_ = errcnt == preverrcnt;  // The device is only considered to be set up if no errors occurred
+    } while (attempt.repeat());
+    return report;
+}
+
+// Puts the LTC2312 in sleep mode, until the next reading (added in version 1.3.0)
+// Note that the next reading will take an additional 1.1ms, since the LTC2312 takes that long to wake up
+void ITUSB2Device::sleepADC(int &errcnt, std::string &errstr)
+{
+    std::lock_guard<std::mutex> lock(spiMutex_);
+    if (adcState_ != ADC_SLEEP) {
+        pulseADC(ADC_SLEEP_PULSES, errcnt, errstr);
+        adcState_ = ADC_SLEEP;
+    }
 }
 
 // Switches both VBUS and the data lines on or off
 void ITUSB2Device::switchUSB(bool value, int &errcnt, std::string &errstr)
 {
-    cp2130_.setGPIOs(CP2130::BMGPIOS * !value, CP2130::BMGPIO1 | CP2130::BMGPIO2 , errcnt, errstr);  // This operates GPIO.1 and GPIO.2 simultaneously
+    Attempt attempt(*this, errcnt, errstr);
+    do {
+        cp2130_.setGPIOs(CP2130::BMGPIOS * !value, CP2130::BMGPIO1 | CP2130::BMGPIO2 , errcnt, errstr);  // This operates GPIO.1 and GPIO.2 simultaneously
+    } while (attempt.repeat());
+}
+
+// Switches both VBUS and the data lines on or off, asynchronously (added in version 1.3.0)
+void ITUSB2Device::switchUSBAsync(EventLoop &loop, bool value, const Completion &completion)
+{
+    watch(loop);
+    setGPIOsAsync(CP2130::BMGPIOS * !value, CP2130::BMGPIO1 | CP2130::BMGPIO2, std::bind(completion, std::placeholders::_2, std::placeholders::_3));
 }
 
 // Switches the USB data lines on or off
 void ITUSB2Device::switchUSBData(bool value, int &errcnt, std::string &errstr)
 {
-    cp2130_.setGPIO2(!value, errcnt, errstr);  // GPIO.2 corresponds to the !UDEN signal
+    Attempt attempt(*this, errcnt, errstr);
+    do {
+        cp2130_.setGPIO2(!value, errcnt, errstr);  // GPIO.2 corresponds to the !UDEN signal
+    } while (attempt.repeat());
+}
+
+// Switches the USB data lines on or off, asynchronously (added in version 1.3.0)
+void ITUSB2Device::switchUSBDataAsync(EventLoop &loop, bool value, const Completion &completion)
+{
+    watch(loop);
+    setGPIOsAsync(CP2130::BMGPIOS * !value, CP2130::BMGPIO2, std::bind(completion, std::placeholders::_2, std::placeholders::_3));
 }
 
 // Switches VBUS on or off
 void ITUSB2Device::switchUSBPower(bool value, int &errcnt, std::string &errstr)
 {
-    cp2130_.setGPIO1(!value, errcnt, errstr);  // GPIO.1 corresponds to the !UPEN signal
+    Attempt attempt(*this, errcnt, errstr);
+    do {
+        cp2130_.setGPIO1(!value, errcnt, errstr);  // GPIO.1 corresponds to the !UPEN signal
+    } while (attempt.repeat());
+}
+
+// Switches VBUS on or off, asynchronously (added in version 1.3.0)
+void ITUSB2Device::switchUSBPowerAsync(EventLoop &loop, bool value, const Completion &completion)
+{
+    watch(loop);
+    setGPIOsAsync(CP2130::BMGPIOS * !value, CP2130::BMGPIO1, std::bind(completion, std::placeholders::_2, std::placeholders::_3));
+}
+
+// Returns the path of the calibration file (an empty string means that no calibration data should be used) (added in version 1.3.0)
+std::string ITUSB2Device::calibrationPath()
+{
+    const char *env = std::getenv("ITUSB2_CALIBRATION");
+    return env == nullptr ? DEFAULT_CALIBRATION : env;
+}
+
+// Gets the status of every device that is connected, by querying all devices concurrently (added in version 1.3.0)
+// A device whose query is not complete within the given time is reported as timed out, so that an unresponsive device does not affect the results obtained from the others
+// The query threads are always joined before returning, which may take longer than the given time, though never longer than the USB transfer timeouts allow
+// The devices are enumerated once, and each one is then opened at its location (see openLocation())
+std::vector<ITUSB2Device::DeviceStatus> ITUSB2Device::getAllStatus(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr)
+{
+    std::vector<CP2130::DeviceLocation> locations = CP2130::locateDevices(VID, PID, errcnt, errstr);
+    std::vector<std::future<DeviceStatus>> futures;
+    std::vector<std::thread> threads;
+    futures.reserve(locations.size());
+    threads.reserve(locations.size());
+    for (const CP2130::DeviceLocation &location : locations) {
+        std::shared_ptr<std::promise<DeviceStatus>> promise = std::make_shared<std::promise<DeviceStatus>>();  // Shared, so that a query that times out can still complete safely
+        futures.push_back(promise->get_future());
+        threads.push_back(std::thread(queryStatus, location, promise));
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;  // All queries start at the same time, therefore they share the same deadline
+    std::vector<DeviceStatus> devices;
+    devices.reserve(locations.size());
+    for (size_t i = 0; i < futures.size(); ++i) {
+        if (futures[i].wait_until(deadline) == std::future_status::ready) {
+            devices.push_back(futures[i].get());
+        } else {
+            devices.push_back({locations[i].serial, false, "timeout", {false, false, false, false, false, 0}});
+        }
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return devices;
 }
 
 // Helper function that returns the hardware revision from a given USB configuration
@@ -231,8 +1368,164 @@ std::string ITUSB2Device::hardwareRevision(const CP2130::USBConfig &config)
     return revision;
 }
 
+// Lists all devices along with their location, hardware revision, CP2130 silicon version and maximum power, querying them concurrently (added in version 1.3.0)
+// As in getAllStatus(), a device that does not respond within the given timeout is reported as such, the query threads are joined before returning, and devices in use are reported as busy
+std::vector<ITUSB2Device::DeviceDetails> ITUSB2Device::listDeviceDetails(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr)
+{
+    std::vector<CP2130::DeviceLocation> locations = CP2130::locateDevices(VID, PID, errcnt, errstr);
+    std::vector<std::future<DeviceDetails>> futures;
+    std::vector<std::thread> threads;
+    futures.reserve(locations.size());
+    threads.reserve(locations.size());
+    for (const CP2130::DeviceLocation &location : locations) {
+        std::shared_ptr<std::promise<DeviceDetails>> promise = std::make_shared<std::promise<DeviceDetails>>();  // Shared, so that a query that times out can still complete safely
+        futures.push_back(promise->get_future());
+        threads.push_back(std::thread(queryDetails, location, promise));
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<DeviceDetails> devices;
+    devices.reserve(locations.size());
+    for (size_t i = 0; i < futures.size(); ++i) {
+        if (futures[i].wait_until(deadline) == std::future_status::ready) {
+            devices.push_back(futures[i].get());
+        } else {
+            devices.push_back({locations[i], false, false, "timeout", "", {0, 0}, 0});
+        }
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return devices;
+}
+
 // Helper function to list devices
 std::list<std::string> ITUSB2Device::listDevices(int &errcnt, std::string &errstr)
 {
     return CP2130::listDevices(VID, PID, errcnt, errstr);
 }
+
+// Parses a retry policy in the form "RETRIES[:RECONNECT]", where RECONNECT is the time to wait for the device to come back in milliseconds, returning false if it is not valid (added in version 1.3.0)
+// The retries are spaced by a delay that starts at 1ms and doubles each time, up to 64ms - If RECONNECT is omitted or zero, automatic reconnection is disabled
+bool ITUSB2Device::parseRetryPolicy(const std::string &spec, RetryPolicy &policy)
+{
+    char *end;
+    long retries = std::strtol(spec.c_str(), &end, 10);
+    long reconnect = 0;
+    bool valid = end != spec.c_str() && retries >= 0 && retries <= RETRY_MAX;
+    if (valid && *end == ':') {
+        const char *start = end + 1;
+        reconnect = std::strtol(start, &end, 10);
+        valid = end != start && reconnect >= 0 && reconnect <= INT_MAX;
+    }
+    valid = valid && *end == '\0';
+    if (valid) {
+        policy.transfers.retries = static_cast<uint8_t>(retries);
+        policy.transfers.initialDelay = RETRY_INITIAL_DELAY;
+        policy.transfers.maxDelay = RETRY_MAX_DELAY;
+        policy.reconnect = std::chrono::milliseconds(reconnect);
+    }
+    return valid;
+}
+
+// Reads the calibration data of the device having the given serial number from the calibration file (added in version 1.3.0)
+// Each line of the file consists of a serial number, followed by any of "offset=MA", "gain=FACTOR" and "CODE:MA" (table points, in ascending order of code), separated by spaces
+// Empty lines and lines starting with "#" are ignored - Returns true if calibration data was found (a missing file simply contains no calibration data)
+bool ITUSB2Device::readCalibration(const std::string &serial, Calibration &calibration, int &errcnt, std::string &errstr)
+{
+    std::string path = calibrationPath();
+    std::ifstream file(path);
+    std::string line;
+    size_t lineNumber = 0;
+    bool found = false;
+    while (!found && std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream stream(line);
+        std::string token;
+        if (stream >> token && token == serial) {
+            Calibration parsed = {0, 1, {}};
+            bool valid = true;
+            while (valid && stream >> token) {
+                size_t colon = token.find(':');
+                if (token.compare(0, 7, "offset=") == 0) {
+                    valid = parseFloat(token.c_str() + 7, parsed.offset);
+                } else if (token.compare(0, 5, "gain=") == 0) {
+                    valid = parseFloat(token.c_str() + 5, parsed.gain);
+                } else if (colon != std::string::npos) {
+                    char *end;
+                    unsigned long code = std::strtoul(token.c_str(), &end, 10);
+                    float current;
+                    valid = colon > 0 && end == token.c_str() + colon && code < ADC_CODES && (parsed.points.empty() || code > parsed.points.back().first) && parseFloat(token.c_str() + colon + 1, current);
+                    if (valid) {
+                        parsed.points.push_back(std::make_pair(static_cast<uint16_t>(code), current));
+                    }
+                } else {
+                    valid = false;
+                }
+            }
+            if (valid) {
+                calibration = parsed;
+                found = true;
+            } else {
+                ++errcnt;
+                errstr += "Invalid calibration data for device " + serial + " in \"" + path + "\", line " + std::to_string(lineNumber) + ".\n";
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+// Switches the given lines of all the given devices on or off at once, returning the measured skew (added in version 1.3.0)
+// The transfers are submitted back to back from a single event loop thread, and then complete concurrently, so that the skew does not grow with the number of devices
+// Unlike the synchronous functions, failed transfers are not retried, since a retry would defeat the purpose of switching the devices at once
+// Important: the devices must not be operated by other threads while this function runs!
+ITUSB2Device::GroupTiming ITUSB2Device::switchGroup(const std::vector<ITUSB2Device *> &devices, uint16_t lines, bool value, int &errcnt, std::string &errstr)
+{
+    GroupTiming timing = {0, 0, 0};
+    size_t count = devices.size();
+    std::vector<std::chrono::steady_clock::time_point> submissions(count), completions(count);
+    std::vector<int> errcnts(count, 0);
+    std::vector<std::string> errstrs(count);
+    size_t pending = count;
+    std::mutex mutex;
+    std::condition_variable completed;
+    EventLoop loop;  // Stopped by its destructor, before anything else goes out of scope, including on the error path
+    for (ITUSB2Device *device : devices) {
+        device->watch(loop);
+    }
+    loop.post([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            submissions[i] = std::chrono::steady_clock::now();
+            devices[i]->setGPIOsAsync(CP2130::BMGPIOS * !value, lines, [&, i](const std::vector<uint8_t> &data, int transferErrcnt, const std::string &transferErrstr) {  // The lines are active low
+                (void)data;
+                completions[i] = std::chrono::steady_clock::now();
+                errcnts[i] = transferErrcnt;
+                errstrs[i] = transferErrstr;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) {
+                    completed.notify_one();
+                }
+            });
+        }
+    });
+    loop.start();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait(lock, [&]() {
+            return pending == 0;  // Every transfer completes, if only by timing out
+        });
+    }
+    loop.stop();
+    for (size_t i = 0; i < count; ++i) {
+        devices[i]->unwatch();  // The loop goes out of scope
+        errcnt += errcnts[i];
+        errstr += errstrs[i];
+    }
+    if (count > 0) {
+        std::chrono::steady_clock::time_point firstSubmission = *std::min_element(submissions.begin(), submissions.end()), lastCompletion = *std::max_element(completions.begin(), completions.end());
+        timing.submissionSkew = toMicroseconds(*std::max_element(submissions.begin(), submissions.end()) - firstSubmission);
+        timing.completionSkew = toMicroseconds(lastCompletion - *std::min_element(completions.begin(), completions.end()));
+        timing.duration = toMicroseconds(lastCompletion - firstSubmission);
+    }
+    return timing;
+}
@@ -1,4 +1,4 @@
-/* ITUSB2 device class - Version 1.2.1
+/* ITUSB2 device class - Version 1.3.0
    Requires CP2130 class version 1.1.0 or later
    Copyright (c) 2021-2022 Samuel Lourenço
 
@@ -23,17 +23,65 @@
 #define ITUSB2DEVICE_H
 
 // Includes
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
+#include "awaitable.h"
 #include "cp2130.h"
+#include "eventloop.h"
 
 class ITUSB2Device
 {
 private:
     CP2130 cp2130_;
+    std::mutex spiMutex_;                                    // Serializes the chip select/SPI critical sections, and guards the ADC state and the current table (added in version 1.3.0)
+    std::atomic<bool> configured_;                           // The members below are atomic since version 1.3.0, so that they can be accessed from any thread
+    std::atomic<uint64_t> attachCycles_;
+    std::atomic<int> adcState_;
+    std::chrono::steady_clock::time_point lastConversion_;
+    std::vector<int32_t> currentTable_;
+    std::atomic<bool> calibrated_;
+    std::atomic<uint64_t> sleeps_;
+    std::atomic<int64_t> sleepLatenessSum_, sleepLatenessMax_;  // In nanoseconds
+    std::atomic<EventLoop *> loop_;                          // Event loop that handles the asynchronous operations, if any (added in version 1.3.0)
+    std::mutex spiQueueMutex_;                               // Guards the two members below (added in version 1.3.0)
+    bool spiQueueBusy_;                                      // True while an asynchronous SPI sequence holds the SPI mutex, or is about to
+    std::deque<std::function<void()>> spiQueue_;             // Asynchronous SPI sequences waiting for their turn
+    std::string serial_;                                     // Serial number given when the device was opened, used to reopen it (added in version 1.3.0)
+    bool direct_;                                            // True if the device was opened by openDirect() (added in version 1.3.0)
+    std::chrono::milliseconds reconnectTimeout_;             // Time to wait for the device to come back, when reconnecting automatically (added in version 1.3.0)
+    bool reconnecting_;                                      // True while reconnect() is running (added in version 1.3.0)
+    std::atomic<uint64_t> reconnects_;                       // Number of times the device was reconnected (added in version 1.3.0)
 
+    class Attempt;
+    struct CurrentSampling;
+
+    void acquireSPIAsync(EventLoop &loop, const std::function<void()> &sequence);
     uint16_t getRawCurrent(int &errcnt, std::string &errstr);
+    bool loadCalibration(int &errcnt, std::string &errstr);
+    void lockSPIAsync(EventLoop &loop, const std::function<void()> &sequence);
+    float measureCurrent(int &errcnt, std::string &errstr);
+    void pulseADC(int pulses, int &errcnt, std::string &errstr);
+    void readRawCurrentAsync(const CP2130::TransferCallback &callback);
+    void recordSleep(const std::chrono::steady_clock::duration &lateness);
+    void releaseSPIAsync(EventLoop &loop);
+    void resetCounters();
+    void resetState();
+    void sampleCurrentAsync(const std::shared_ptr<CurrentSampling> &sampling, int step);
+    void setGPIOsAsync(uint16_t values, uint16_t mask, const CP2130::TransferCallback &callback);
+    void unwatch();
+    void waitAsync(EventLoop &loop, const std::chrono::steady_clock::time_point &deadline, const std::function<void()> &task);
+    void waitUntil(const std::chrono::steady_clock::time_point &deadline);
+    bool wakeADC(int &errcnt, std::string &errstr);
+    void watch(EventLoop &loop);
 
 public:
     // Class definitions
@@ -43,17 +91,146 @@ public:
     static const int ERROR_INIT = CP2130::ERROR_INIT;            // Returned by open() in case of a libusb initialization failure
     static const int ERROR_NOT_FOUND = CP2130::ERROR_NOT_FOUND;  // Returned by open() if the device was not found
     static const int ERROR_BUSY = CP2130::ERROR_BUSY;            // Returned by open() if the device is already in use
+    static const int ADC_UNKNOWN = 0;                            // Returned by adcState() if the power state of the LTC2312 is not known (e.g., right after opening the device)
+    static const int ADC_AWAKE = 1;                              // Returned by adcState() if the LTC2312 is awake
+    static const int ADC_NAP = 2;                                // Returned by adcState() if the LTC2312 is in nap mode (or possibly awake)
+    static const int ADC_SLEEP = 3;                              // Returned by adcState() if the LTC2312 is in sleep mode
+    static const uint16_t LINES_POWER = CP2130::BMGPIO1;         // Selects VBUS, in switchGroup()
+    static const uint16_t LINES_DATA = CP2130::BMGPIO2;          // Selects the data lines, in switchGroup()
+    static const uint16_t SIGNAL_UPEN = CP2130::BMGPIO1;         // Bitmap for the !UPEN signal (VBUS enable, active low), applicable to getSignals()
+    static const uint16_t SIGNAL_UDEN = CP2130::BMGPIO2;         // Bitmap for the !UDEN signal (data lines enable, active low), applicable to getSignals()
+    static const uint16_t SIGNAL_UDOC = CP2130::BMGPIO3;         // Bitmap for the !UDOC signal (overcurrent fault, active low), applicable to getSignals()
+    static const uint16_t SIGNAL_UDCD = CP2130::BMGPIO4;         // Bitmap for the UDCD signal (DUT connection detected), applicable to getSignals()
+    static const uint16_t SIGNAL_UDHS = CP2130::BMGPIO5;         // Bitmap for the UDHS signal (DUT linked at high speed), applicable to getSignals()
+    static const uint16_t SIGNALS = SIGNAL_UPEN | SIGNAL_UDEN | SIGNAL_UDOC | SIGNAL_UDCD | SIGNAL_UDHS;  // Bitmap for all the above signals
+
+    struct Calibration {
+        float offset;                                    // Offset added to the current, in mA
+        float gain;                                      // Gain applied to the current, before adding the offset
+        std::vector<std::pair<uint16_t, float>> points;  // Optional piecewise linear table, mapping raw codes to currents in mA, sorted by code (replaces the nominal conversion if not empty)
+    };
+
+    struct Counters {
+        uint64_t controlTransfers;  // Number of control transfers issued since the device was opened
+        uint64_t bulkTransfers;     // Number of bulk transfers issued since the device was opened
+        uint64_t transferErrors;    // Number of failed transfers since the device was opened
+        uint64_t attachCycles;      // Number of times the DUT was attached since the device was opened (either by attach() or by enumerate())
+        uint64_t retries;           // Number of control transfers that were retried since the device was opened (added in version 1.3.0)
+        uint64_t reconnects;        // Number of times the device was reconnected since it was opened (added in version 1.3.0)
+    };
+
+    struct CurrentLimit {
+        float threshold;    // Instantaneous current limit, in mA (zero disables this limit)
+        float rating;       // Continuous current rating, in mA (the I2t budget is consumed while the current is above this value, and replenished while below)
+        float budget;       // I2t budget, in mA^2*s (zero disables this limit)
+        bool data;          // If true, the data lines are disconnected along with VBUS when tripping
+    };
+
+    struct CurrentTrip {
+        bool tripped;        // False if monitoring stopped without a trip
+        bool i2t;            // True if the trip was caused by the I2t budget being exceeded, false if caused by the instantaneous limit
+        float current;       // Current reading that caused the trip, in mA
+        uint32_t samples;    // Number of samples taken
+        uint64_t time;       // Time at which the trip occurred, in microseconds since monitoring started
+        uint32_t detection;  // Time from the previous sample until the condition was detected, in microseconds
+        uint32_t switching;  // Time taken to switch off, in microseconds
+        uint32_t maxPeriod;  // Longest sampling period observed, in microseconds (the worst-case reaction time is this value plus the switching time)
+    };
+
+    struct RetryPolicy {
+        CP2130::RetryPolicy transfers;        // Policy according to which failed idempotent control transfers are retried
+        std::chrono::milliseconds reconnect;  // Time to wait for the device to come back, when reconnecting it automatically (zero disables automatic reconnection)
+    };
+
+    struct Status {
+        bool up;        // VBUS status (true if switched on)
+        bool ud;        // Data lines status (true if connected)
+        bool cd;        // DUT connection status (true if detected)
+        bool hs;        // DUT link speed status (true if high speed)
+        bool oc;        // Over-current or over-temperature fault status (true if a fault was detected)
+        float current;  // VBUS current, in mA
+
+        bool operator ==(const Status &other) const;
+        bool operator !=(const Status &other) const;
+    };
+
+    struct DeviceDetails {
+        CP2130::DeviceLocation location;        // Serial number and location on the USB topology
+        bool busy;                              // True if the device is in use by another process
+        bool valid;                             // True if the details below were obtained, false otherwise
+        std::string error;                      // Reason why the details could not be obtained ("busy", "not found", "disconnected", "error" or "timeout"), if applicable
+        std::string hardwareRevision;           // Hardware revision, as given by hardwareRevision()
+        CP2130::SiliconVersion siliconVersion;  // Silicon version of the CP2130
+        uint16_t maxPower;                      // Maximum consumption current declared by the device, in mA
+    };
+
+    struct DeviceStatus {
+        std::string serial;  // Serial number of the device
+        bool valid;          // True if the status was obtained, false otherwise
+        std::string error;   // Reason why the status could not be obtained ("busy", "not found", "disconnected", "error" or "timeout"), if applicable
+        Status status;       // Status of the device, only meaningful if "valid" is true
+    };
+
+    struct GroupTiming {
+        uint32_t submissionSkew;  // Time between the first and the last transfer submissions, in microseconds
+        uint32_t completionSkew;  // Time between the first and the last transfer completions, in microseconds
+        uint32_t duration;        // Time from the first submission to the last completion, in microseconds
+    };
+
+    struct EnumTiming {
+        bool cd;                // True if the DUT was detected (UDCD asserted)
+        bool hs;                // True if the DUT linked at high speed (UDHS asserted)
+        uint32_t cdLatency;     // Time from VBUS on to UDCD assertion, in microseconds
+        uint32_t cdResolution;  // Uncertainty of the above, in microseconds (interval between the two polls that bracket the assertion)
+        uint32_t hsLatency;     // Time from UDCD assertion to UDHS assertion, in microseconds
+        uint32_t hsResolution;  // Uncertainty of the above, in microseconds
+        uint16_t cdEdges;       // Number of UDCD rising edges counted by the CP2130 event counter since VBUS was switched on (more than one indicates connection bounces)
+        bool cdOverflow;        // True if the event counter overflowed, in which case "cdEdges" is not meaningful
+    };
+
+    struct SetupReport {
+        bool modeSkipped;    // True if the SPI mode of channel 0 was already configured, and therefore not written
+        bool delaysSkipped;  // True if the SPI delays of channel 0 were already disabled, and therefore not written
+        bool wakeupSkipped;  // True if the LTC2312 wake-up sequence was skipped, because the device was found already set up
+        bool calibrated;     // True if calibration data was found for the device, and applied
+    };
+
+    struct SleepJitter {
+        uint64_t sleeps;  // Number of timed waits since the device object was created
+        double mean;      // Mean lateness of the wake-ups, in microseconds
+        double max;       // Maximum lateness of the wake-ups, in microseconds
+    };
+
+    // Callbacks for the asynchronous operations, which are called from the event loop thread (added in version 1.3.0)
+    typedef std::function<void(int errcnt, const std::string &errstr)> Completion;
+    typedef std::function<void(float current, int errcnt, const std::string &errstr)> CurrentCompletion;
+    typedef std::function<void(uint16_t signals, int errcnt, const std::string &errstr)> SignalsCompletion;
+    typedef std::function<void(const Status &status, int errcnt, const std::string &errstr)> StatusCompletion;
 
     ITUSB2Device();
+    ~ITUSB2Device();
 
+    int adcState() const;
+    bool calibrated() const;
+    Counters counters() const;
     bool disconnected() const;
+    bool isConfigured() const;
     bool isOpen() const;
+    RetryPolicy retryPolicy() const;
+    SleepJitter sleepJitter() const;
+    uint64_t transfers() const;
 
+    void armConnectionCounter(int &errcnt, std::string &errstr);
     void attach(int &errcnt, std::string &errstr);
+    void attachAsync(EventLoop &loop, const Completion &completion);
     void close();
     void detach(int &errcnt, std::string &errstr);
+    void detachAsync(EventLoop &loop, const Completion &completion);
+    EnumTiming enumerate(int &errcnt, std::string &errstr);
     CP2130::SiliconVersion getCP2130SiliconVersion(int &errcnt, std::string &errstr);
+    CP2130::EventCounter getConnectionCounter(int &errcnt, std::string &errstr);
     float getCurrent(int &errcnt, std::string &errstr);
+    void getCurrentAsync(EventLoop &loop, const CurrentCompletion &completion);
     bool getDUTConnectionStatus(int &errcnt, std::string &errstr);
     bool getDUTSpeedStatus(int &errcnt, std::string &errstr);
     std::string getHardwareRevision(int &errcnt, std::string &errstr);
@@ -61,18 +238,135 @@ public:
     bool getOvercurrentStatus(int &errcnt, std::string &errstr);
     std::u16string getProductDesc(int &errcnt, std::string &errstr);
     std::u16string getSerialDesc(int &errcnt, std::string &errstr);
+    uint16_t getSignals(int &errcnt, std::string &errstr);
+    void getSignalsAsync(EventLoop &loop, const SignalsCompletion &completion);
+    Status getStatus(int &errcnt, std::string &errstr);
+    void getStatusAsync(EventLoop &loop, const StatusCompletion &completion);
     CP2130::USBConfig getUSBConfig(int &errcnt, std::string &errstr);
     bool getUSBDataStatus(int &errcnt, std::string &errstr);
     bool getUSBPowerStatus(int &errcnt, std::string &errstr);
+    void idleADC(const std::chrono::microseconds &idle, int &errcnt, std::string &errstr);
+    CurrentTrip limitCurrent(const CurrentLimit &limit, const std::atomic<bool> &stop, int &errcnt, std::string &errstr);
+    void napADC(int &errcnt, std::string &errstr);
     int open(const std::string &serial = std::string());
+    int openDirect(const std::string &serial = std::string());
+    int openLocation(const CP2130::DeviceLocation &location);
+    bool reconnect(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr);
     void reset(int &errcnt, std::string &errstr);
-    void setup(int &errcnt, std::string &errstr);
+    CP2130::ResetTiming resetAndReopen(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr);
+    void setCalibration(const Calibration &calibration);
+    void setRetryPolicy(const RetryPolicy &policy, int &errcnt, std::string &errstr);
+    SetupReport setup(int &errcnt, std::string &errstr);
+    void sleepADC(int &errcnt, std::string &errstr);
     void switchUSB(bool value, int &errcnt, std::string &errstr);
+    void switchUSBAsync(EventLoop &loop, bool value, const Completion &completion);
     void switchUSBData(bool value, int &errcnt, std::string &errstr);
+    void switchUSBDataAsync(EventLoop &loop, bool value, const Completion &completion);
     void switchUSBPower(bool value, int &errcnt, std::string &errstr);
+    void switchUSBPowerAsync(EventLoop &loop, bool value, const Completion &completion);
 
+    static std::string calibrationPath();
+    static std::vector<DeviceStatus> getAllStatus(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr);
     static std::string hardwareRevision(const CP2130::USBConfig &config);
+    static std::vector<DeviceDetails> listDeviceDetails(const std::chrono::milliseconds &timeout, int &errcnt, std::string &errstr);
     static std::list<std::string> listDevices(int &errcnt, std::string &errstr);
+    static bool parseRetryPolicy(const std::string &spec, RetryPolicy &policy);
+    static bool readCalibration(const std::string &serial, Calibration &calibration, int &errcnt, std::string &errstr);
+    static GroupTiming switchGroup(const std::vector<ITUSB2Device *> &devices, uint16_t lines, bool value, int &errcnt, std::string &errstr);
+
+#if __cplusplus >= 202002L
+    // Awaitable versions of the asynchronous operations, for use in coroutines (added in version 1.3.0)
+    Awaitable<void> attachAsync(EventLoop &loop);
+    Awaitable<void> detachAsync(EventLoop &loop);
+    Awaitable<float> getCurrentAsync(EventLoop &loop);
+    Awaitable<uint16_t> getSignalsAsync(EventLoop &loop);
+    Awaitable<Status> getStatusAsync(EventLoop &loop);
+    Awaitable<void> switchUSBAsync(EventLoop &loop, bool value);
+    Awaitable<void> switchUSBDataAsync(EventLoop &loop, bool value);
+    Awaitable<void> switchUSBPowerAsync(EventLoop &loop, bool value);
+#endif
 };
 
+#if __cplusplus >= 202002L
+// Awaitable version of attachAsync() (added in version 1.3.0)
+inline Awaitable<void> ITUSB2Device::attachAsync(EventLoop &loop)
+{
+    return Awaitable<void>([this, &loop](const Awaitable<void>::Resumer &resume) {
+        attachAsync(loop, [resume](int errcnt, const std::string &errstr) {
+            resume({errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of detachAsync() (added in version 1.3.0)
+inline Awaitable<void> ITUSB2Device::detachAsync(EventLoop &loop)
+{
+    return Awaitable<void>([this, &loop](const Awaitable<void>::Resumer &resume) {
+        detachAsync(loop, [resume](int errcnt, const std::string &errstr) {
+            resume({errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of getCurrentAsync() (added in version 1.3.0)
+inline Awaitable<float> ITUSB2Device::getCurrentAsync(EventLoop &loop)
+{
+    return Awaitable<float>([this, &loop](const Awaitable<float>::Resumer &resume) {
+        getCurrentAsync(loop, [resume](float current, int errcnt, const std::string &errstr) {
+            resume({current, errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of getSignalsAsync() (added in version 1.3.0)
+inline Awaitable<uint16_t> ITUSB2Device::getSignalsAsync(EventLoop &loop)
+{
+    return Awaitable<uint16_t>([this, &loop](const Awaitable<uint16_t>::Resumer &resume) {
+        getSignalsAsync(loop, [resume](uint16_t signals, int errcnt, const std::string &errstr) {
+            resume({signals, errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of getStatusAsync() (added in version 1.3.0)
+inline Awaitable<ITUSB2Device::Status> ITUSB2Device::getStatusAsync(EventLoop &loop)
+{
+    return Awaitable<Status>([this, &loop](const Awaitable<Status>::Resumer &resume) {
+        getStatusAsync(loop, [resume](const Status &status, int errcnt, const std::string &errstr) {
+            resume({status, errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of switchUSBAsync() (added in version 1.3.0)
+inline Awaitable<void> ITUSB2Device::switchUSBAsync(EventLoop &loop, bool value)
+{
+    return Awaitable<void>([this, &loop, value](const Awaitable<void>::Resumer &resume) {
+        switchUSBAsync(loop, value, [resume](int errcnt, const std::string &errstr) {
+            resume({errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of switchUSBDataAsync() (added in version 1.3.0)
+inline Awaitable<void> ITUSB2Device::switchUSBDataAsync(EventLoop &loop, bool value)
+{
+    return Awaitable<void>([this, &loop, value](const Awaitable<void>::Resumer &resume) {
+        switchUSBDataAsync(loop, value, [resume](int errcnt, const std::string &errstr) {
+            resume({errcnt, errstr});
+        });
+    });
+}
+
+// Awaitable version of switchUSBPowerAsync() (added in version 1.3.0)
+inline Awaitable<void> ITUSB2Device::switchUSBPowerAsync(EventLoop &loop, bool value)
+{
+    return Awaitable<void>([this, &loop, value](const Awaitable<void>::Resumer &resume) {
+        switchUSBPowerAsync(loop, value, [resume](int errcnt, const std::string &errstr) {
+            resume({errcnt, errstr});
+        });
+    });
+}
+#endif
+
 #endif  // ITUSB2DEVICE_H
@@ -0,0 +1,384 @@
+/* ITUSB2 C API - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// This file wraps ITUSB2Device in a plain C interface, so that the library can be loaded in-process by programs written in other languages
+// No C++ exception crosses this interface: any exception is caught and reported as ITUSB2_ERROR_INTERNAL
+// Error details are kept per thread, as with errno, so that a handle can be shared between threads (see itusb2device.cpp for the thread safety of the device itself)
+
+// Includes
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <new>
+#include <string>
+#include "itusb2device.h"
+#include "libitusb2.h"
+
+// Definitions
+struct itusb2_device {
+    ITUSB2Device device;
+};
+
+// Global variables
+static thread_local std::string lastError;
+
+// Records the given error message for itusb2_last_error(), and returns the given error code
+static int fail(int error, const std::string &message)
+{
+    lastError = message;
+    return error;
+}
+
+// Records the outcome of an operation on the given device, and returns the corresponding error code
+static int result(const itusb2_device *device, int errcnt, const std::string &errstr)
+{
+    int error;
+    if (errcnt == 0) {
+        lastError.clear();
+        error = ITUSB2_SUCCESS;
+    } else {
+        error = fail(device->device.disconnected() ? ITUSB2_ERROR_DISCONNECTED : ITUSB2_ERROR_DEVICE, errstr);
+    }
+    return error;
+}
+
+// Attaches the DUT (see ITUSB2Device::attach())
+int itusb2_attach(itusb2_device *device)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.attach(errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Closes the device and frees the handle (a null handle is ignored)
+void itusb2_close(itusb2_device *device)
+{
+    try {
+        delete device;  // The destructor of ITUSB2Device closes the device safely
+    } catch (...) {
+    }
+}
+
+// Detaches the DUT (see ITUSB2Device::detach())
+int itusb2_detach(itusb2_device *device)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.detach(errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Frees a list of serial numbers returned by itusb2_list_serials() (a null list is ignored)
+void itusb2_free_serials(char **serials)
+{
+    if (serials != nullptr) {
+        for (char **serial = serials; *serial != nullptr; ++serial) {
+            delete[] *serial;
+        }
+        delete[] serials;
+    }
+}
+
+// Gets the VBUS current, in mA
+int itusb2_get_current(itusb2_device *device, float *current)
+{
+    if (device == nullptr || current == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle or output pointer.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        *current = device->device.getCurrent(errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Gets the serial number of the device, as a null-terminated string that is truncated to fit in the given buffer
+int itusb2_get_serial(itusb2_device *device, char *serial, size_t size)
+{
+    if (device == nullptr || serial == nullptr || size == 0) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle or output buffer.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        std::u16string serialDesc = device->device.getSerialDesc(errcnt, errstr);
+        std::string serialStr(serialDesc.begin(), serialDesc.end());  // Serial numbers are plain ASCII
+        size_t length = std::min(serialStr.size(), size - 1);
+        std::memcpy(serial, serialStr.c_str(), length);
+        serial[length] = '\0';
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Gets the raw state of the signals, from a single transfer (see the ITUSB2_SIGNAL_* bitmaps)
+int itusb2_get_signals(itusb2_device *device, uint16_t *signals)
+{
+    if (device == nullptr || signals == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle or output pointer.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        *signals = device->device.getSignals(errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Gets the complete status of the device, including the VBUS current
+int itusb2_get_status(itusb2_device *device, itusb2_status *status)
+{
+    if (device == nullptr || status == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle or output pointer.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        ITUSB2Device::Status deviceStatus = device->device.getStatus(errcnt, errstr);
+        status->up = deviceStatus.up;
+        status->ud = deviceStatus.ud;
+        status->cd = deviceStatus.cd;
+        status->hs = deviceStatus.hs;
+        status->oc = deviceStatus.oc;
+        status->current = deviceStatus.current;
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Returns the details of the last error that occurred in the calling thread, or an empty string if the last call succeeded
+// The returned string is valid until the next call to this library, from the same thread
+const char *itusb2_last_error(void)
+{
+    return lastError.c_str();
+}
+
+// Lists the serial numbers of all connected devices, as a null-terminated array that must be freed with itusb2_free_serials()
+int itusb2_list_serials(char ***serials, size_t *count)
+{
+    if (serials == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null output pointer.\n");
+    }
+    *serials = nullptr;
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        std::list<std::string> list = ITUSB2Device::listDevices(errcnt, errstr);
+        if (errcnt > 0) {
+            return fail(ITUSB2_ERROR_INIT, errstr);  // Listing can only fail if libusb could not be initialized
+        }
+        char **array = new char *[list.size() + 1]();
+        size_t i = 0;
+        for (const std::string &serial : list) {
+            array[i] = new (std::nothrow) char[serial.size() + 1];
+            if (array[i] == nullptr) {
+                itusb2_free_serials(array);
+                return fail(ITUSB2_ERROR_INTERNAL, "Out of memory.\n");
+            }
+            std::strcpy(array[i], serial.c_str());
+            ++i;
+        }
+        *serials = array;
+        if (count != nullptr) {
+            *count = list.size();
+        }
+        lastError.clear();
+        return ITUSB2_SUCCESS;
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Opens the device having the given serial number (or the first device found, if the serial number is null or empty), and prepares it for current measurements
+// Note that the device can't be opened while held by the daemon, in which case ITUSB2_ERROR_BUSY is returned
+int itusb2_open(const char *serial, itusb2_device **device)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null output pointer.\n");
+    }
+    *device = nullptr;
+    try {
+        itusb2_device *handle = new itusb2_device;
+        int err = handle->device.open(serial == nullptr ? std::string() : std::string(serial));
+        if (err != ITUSB2Device::SUCCESS) {
+            delete handle;
+            if (err == ITUSB2Device::ERROR_INIT) {
+                return fail(ITUSB2_ERROR_INIT, "Could not initialize libusb\n");
+            } else if (err == ITUSB2Device::ERROR_NOT_FOUND) {
+                return fail(ITUSB2_ERROR_NOT_FOUND, "Could not find device.\n");
+            } else {
+                return fail(ITUSB2_ERROR_BUSY, "Device is currently unavailable.\n");
+            }
+        }
+        int errcnt = 0;
+        std::string errstr;
+        handle->device.setup(errcnt, errstr);  // Prepare the device (SPI setup), so that the handle is ready for any operation
+        int error = result(handle, errcnt, errstr);
+        if (error != ITUSB2_SUCCESS) {
+            delete handle;
+            return error;
+        }
+        *device = handle;
+        return ITUSB2_SUCCESS;
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Resets the device, which then reenumerates - The handle can only be closed afterwards
+int itusb2_reset(itusb2_device *device)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.reset(errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Resets the device, waits up to the given time for it to reenumerate, in milliseconds, and reopens it, so that the handle stays usable (added in version 1.1)
+// If "ready" is not null, it is set to the time taken by the device to become ready again, in microseconds
+int itusb2_reset_wait(itusb2_device *device, unsigned int timeout, uint32_t *ready)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        CP2130::ResetTiming timing = device->device.resetAndReopen(std::chrono::milliseconds(timeout), errcnt, errstr);
+        if (ready != nullptr) {
+            *ready = timing.ready;
+        }
+        return timing.departure != 0 && timing.ready == 0 ? fail(ITUSB2_ERROR_TIMEOUT, errstr) : result(device, errcnt, errstr);  // The device was reset, but did not come back in time
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Returns a short description of the given error code
+const char *itusb2_strerror(int error)
+{
+    const char *description;
+    if (error == ITUSB2_SUCCESS) {
+        description = "Success";
+    } else if (error == ITUSB2_ERROR_INIT) {
+        description = "Could not initialize libusb";
+    } else if (error == ITUSB2_ERROR_NOT_FOUND) {
+        description = "Device not found";
+    } else if (error == ITUSB2_ERROR_BUSY) {
+        description = "Device is currently unavailable";
+    } else if (error == ITUSB2_ERROR_DISCONNECTED) {
+        description = "Device disconnected";
+    } else if (error == ITUSB2_ERROR_DEVICE) {
+        description = "Failed operation";
+    } else if (error == ITUSB2_ERROR_INVALID) {
+        description = "Invalid argument";
+    } else if (error == ITUSB2_ERROR_TIMEOUT) {
+        description = "Device did not come back in time";
+    } else if (error == ITUSB2_ERROR_INTERNAL) {
+        description = "Internal error";
+    } else {
+        description = "Unknown error";
+    }
+    return description;
+}
+
+// Connects or disconnects the data lines
+int itusb2_switch_data(itusb2_device *device, int value)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.switchUSBData(value != 0, errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Switches VBUS on or off
+int itusb2_switch_power(itusb2_device *device, int value)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.switchUSBPower(value != 0, errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Switches both VBUS and the data lines on or off, simultaneously
+int itusb2_switch_usb(itusb2_device *device, int value)
+{
+    if (device == nullptr) {
+        return fail(ITUSB2_ERROR_INVALID, "Null device handle.\n");
+    }
+    try {
+        int errcnt = 0;
+        std::string errstr;
+        device->device.switchUSB(value != 0, errcnt, errstr);
+        return result(device, errcnt, errstr);
+    } catch (...) {
+        return fail(ITUSB2_ERROR_INTERNAL, "Internal error.\n");
+    }
+}
+
+// Returns the version of the library, encoded as ITUSB2_VERSION is
+uint32_t itusb2_version(void)
+{
+    return ITUSB2_VERSION;
+}
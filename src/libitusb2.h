@@ -0,0 +1,99 @@
+/* ITUSB2 C API - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef LIBITUSB2_H
+#define LIBITUSB2_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Definitions
+#if defined(__GNUC__)
+#define ITUSB2_API __attribute__((visibility("default")))
+#else
+#define ITUSB2_API
+#endif
+
+// Version of the API declared in this header - Programs can compare it with itusb2_version(), in order to check the library they were linked against
+// Functions are only added in minor versions, and never removed or changed, except in a new major version (which also changes the soname)
+#define ITUSB2_VERSION_MAJOR 1
+#define ITUSB2_VERSION_MINOR 1
+#define ITUSB2_VERSION_PATCH 0
+#define ITUSB2_VERSION ((ITUSB2_VERSION_MAJOR << 16) | (ITUSB2_VERSION_MINOR << 8) | ITUSB2_VERSION_PATCH)
+
+// Values returned by all functions that can fail, which match the error codes of the records printed by the commands (see output.h)
+#define ITUSB2_SUCCESS 0              // Success
+#define ITUSB2_ERROR_INIT 1           // Could not initialize libusb
+#define ITUSB2_ERROR_NOT_FOUND 2      // Device not found
+#define ITUSB2_ERROR_BUSY 3           // Device is in use (e.g., by the daemon)
+#define ITUSB2_ERROR_DISCONNECTED 4   // Device disconnected
+#define ITUSB2_ERROR_DEVICE 5         // Failed operation (e.g., failed transfer)
+#define ITUSB2_ERROR_INVALID 6        // Invalid argument (e.g., null pointer)
+#define ITUSB2_ERROR_TIMEOUT 7        // Device did not come back in time (added in version 1.1)
+#define ITUSB2_ERROR_INTERNAL 9       // Unexpected internal error (e.g., out of memory)
+
+// Bitmaps applicable to itusb2_get_signals()
+#define ITUSB2_SIGNAL_UPEN 0x0010  // !UPEN signal (VBUS enable, active low)
+#define ITUSB2_SIGNAL_UDEN 0x0020  // !UDEN signal (data lines enable, active low)
+#define ITUSB2_SIGNAL_UDOC 0x0040  // !UDOC signal (overcurrent fault, active low)
+#define ITUSB2_SIGNAL_UDCD 0x0080  // UDCD signal (DUT connection detected)
+#define ITUSB2_SIGNAL_UDHS 0x0100  // UDHS signal (DUT linked at high speed)
+
+typedef struct itusb2_device itusb2_device;  // Opaque handle to an open device
+
+typedef struct itusb2_status {
+    int up;         // VBUS status (non-zero if switched on)
+    int ud;         // Data lines status (non-zero if connected)
+    int cd;         // DUT connection status (non-zero if detected)
+    int hs;         // DUT link speed status (non-zero if high speed)
+    int oc;         // Over-current or over-temperature fault status (non-zero if a fault was detected)
+    float current;  // VBUS current, in mA
+} itusb2_status;
+
+// Function prototypes
+ITUSB2_API int itusb2_attach(itusb2_device *device);
+ITUSB2_API void itusb2_close(itusb2_device *device);
+ITUSB2_API int itusb2_detach(itusb2_device *device);
+ITUSB2_API void itusb2_free_serials(char **serials);
+ITUSB2_API int itusb2_get_current(itusb2_device *device, float *current);
+ITUSB2_API int itusb2_get_serial(itusb2_device *device, char *serial, size_t size);
+ITUSB2_API int itusb2_get_signals(itusb2_device *device, uint16_t *signals);
+ITUSB2_API int itusb2_get_status(itusb2_device *device, itusb2_status *status);
+ITUSB2_API const char *itusb2_last_error(void);
+ITUSB2_API int itusb2_list_serials(char ***serials, size_t *count);
+ITUSB2_API int itusb2_open(const char *serial, itusb2_device **device);
+ITUSB2_API int itusb2_reset(itusb2_device *device);
+ITUSB2_API int itusb2_reset_wait(itusb2_device *device, unsigned int timeout, uint32_t *ready);
+ITUSB2_API const char *itusb2_strerror(int error);
+ITUSB2_API int itusb2_switch_data(itusb2_device *device, int value);
+ITUSB2_API int itusb2_switch_power(itusb2_device *device, int value);
+ITUSB2_API int itusb2_switch_usb(itusb2_device *device, int value);
+ITUSB2_API uint32_t itusb2_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBITUSB2_H
@@ -0,0 +1,144 @@
+/* ITUSB2 metrics functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The metrics are formatted according to the Prometheus text exposition format (version 0.0.4), so that they can be scraped without any exporter in between
+// Every sample is labeled with the serial number of the respective device
+
+// Includes
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics.h"
+
+// Definitions
+const double UA_PER_A = 1000000;  // Number of microamperes per ampere
+const double UA_PER_MA = 1000;    // Number of microamperes per milliampere
+
+// Escapes a label value, as required by the exposition format
+static std::string escapeLabel(const std::string &value)
+{
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Formats the given device metrics, returning a text that is ready to be served as a response to a scrape
+std::string formatMetrics(const std::map<std::string, DeviceMetrics> &metrics)
+{
+    struct Family {
+        const char *name;
+        const char *type;
+        const char *help;
+        double (*value)(const DeviceMetrics &);  // Obtains the value of the sample from the device metrics
+        bool polled;                             // True if the sample is only meaningful once the device has been successfully polled
+    };
+    static const Family families[] = {
+        {"itusb2_up", "gauge", "Whether the device responded on the last poll.", [](const DeviceMetrics &m) -> double {return m.up;}, false},
+        {"itusb2_last_poll_timestamp_seconds", "gauge", "Time of the last successful poll, in seconds since the epoch.", [](const DeviceMetrics &m) -> double {return m.timestamp;}, true},
+        {"itusb2_current_amperes", "gauge", "Current drawn by the device under test.", [](const DeviceMetrics &m) -> double {return std::round(m.status.current * UA_PER_MA) / UA_PER_A;}, true},
+        {"itusb2_power_enabled", "gauge", "Whether VBUS is switched on.", [](const DeviceMetrics &m) -> double {return m.status.up;}, true},
+        {"itusb2_data_enabled", "gauge", "Whether the data lines are connected.", [](const DeviceMetrics &m) -> double {return m.status.ud;}, true},
+        {"itusb2_connected", "gauge", "Whether the device under test is connected (UDCD).", [](const DeviceMetrics &m) -> double {return m.status.cd;}, true},
+        {"itusb2_high_speed", "gauge", "Whether the device under test is linked at high speed (UDHS).", [](const DeviceMetrics &m) -> double {return m.status.hs;}, true},
+        {"itusb2_fault", "gauge", "Whether the overcurrent fault flag is active.", [](const DeviceMetrics &m) -> double {return m.status.oc;}, true},
+        {"itusb2_control_transfers_total", "counter", "Number of USB control transfers issued to the device.", [](const DeviceMetrics &m) -> double {return m.controlTransfers;}, false},
+        {"itusb2_bulk_transfers_total", "counter", "Number of USB bulk transfers issued to the device.", [](const DeviceMetrics &m) -> double {return m.bulkTransfers;}, false},
+        {"itusb2_transfer_errors_total", "counter", "Number of failed USB transfers.", [](const DeviceMetrics &m) -> double {return m.transferErrors;}, false},
+        {"itusb2_transfer_retries_total", "counter", "Number of retried USB control transfers.", [](const DeviceMetrics &m) -> double {return m.transferRetries;}, false},
+        {"itusb2_disconnects_total", "counter", "Number of times the device was found disconnected.", [](const DeviceMetrics &m) -> double {return m.disconnects;}, false},
+        {"itusb2_attach_cycles_total", "counter", "Number of times the device under test was attached.", [](const DeviceMetrics &m) -> double {return m.attachCycles;}, false},
+        {"itusb2_overcurrent_trips_total", "counter", "Number of times the overcurrent fault flag was seen to go active.", [](const DeviceMetrics &m) -> double {return m.overcurrentTrips;}, false},
+        {"itusb2_coalesced_requests_total", "counter", "Number of requests that were coalesced with another one, instead of being executed on their own.", [](const DeviceMetrics &m) -> double {return m.coalescedRequests;}, false}
+    };
+    std::ostringstream stream;
+    stream << std::setprecision(15);  // Enough to represent both timestamps and counters exactly
+    for (const Family &family : families) {
+        stream << "# HELP " << family.name << " " << family.help << "\n"
+               << "# TYPE " << family.name << " " << family.type << "\n";
+        for (const std::pair<const std::string, DeviceMetrics> &device : metrics) {
+            if (!family.polled || device.second.timestamp != 0) {
+                stream << family.name << "{serial=\"" << escapeLabel(device.first) << "\"} " << family.value(device.second) << "\n";
+            }
+        }
+    }
+    return stream.str();
+}
+
+// Creates a listening socket for serving metrics, returning its file descriptor, or -1 in case of failure
+// The address is either the path of a Unix socket (it must contain a slash) or "[HOST:]PORT", where HOST must be a loopback address (127.0.0.1 is assumed if omitted)
+int listenMetrics(const std::string &address)
+{
+    int fd = -1;
+    if (address.find('/') != std::string::npos) {
+        sockaddr_un addr = sockaddr_un();
+        if (address.size() < sizeof(addr.sun_path)) {
+            addr.sun_family = AF_UNIX;
+            address.copy(addr.sun_path, address.size());
+            unlink(address.c_str());  // Remove any stale socket left behind by a previous instance
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)) {
+                close(fd);
+                fd = -1;
+            } else if (fd >= 0) {
+                chmod(address.c_str(), 0666);  // Metrics are read only, so any local user may scrape them
+            }
+        }
+    } else {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "" : address.substr(0, colon), port = address.substr(colon == std::string::npos ? 0 : colon + 1);
+        sockaddr_in addr = sockaddr_in();
+        addr.sin_family = AF_INET;
+        char *end;
+        unsigned long portnum = port.empty() ? 0 : std::strtoul(port.c_str(), &end, 10);
+        bool valid = !port.empty() && *end == '\0' && portnum > 0 && portnum <= 65535;
+        if (host.empty() || host == "localhost") {
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        } else {
+            valid = valid && inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1 && ntohl(addr.sin_addr.s_addr) >> 24 == IN_LOOPBACKNET;  // Metrics are never exposed beyond the local host
+        }
+        if (valid) {
+            addr.sin_port = htons(static_cast<uint16_t>(portnum));
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            int reuse = 1;
+            if (fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    return fd;
+}
@@ -0,0 +1,49 @@
+/* ITUSB2 metrics functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// Includes
+#include <cstdint>
+#include <map>
+#include <string>
+#include "itusb2device.h"
+
+// Snapshot of the health and measurements of a device, as last seen by the daemon (formatting a snapshot never requires a transfer)
+struct DeviceMetrics {
+    bool up;                       // True if the device was open and responded on the last poll
+    ITUSB2Device::Status status;   // Status obtained on the last successful poll
+    double timestamp;              // Time of the last successful poll, in seconds since the epoch (zero if never polled)
+    uint64_t controlTransfers;     // Number of control transfers issued since the daemon started
+    uint64_t bulkTransfers;        // Number of bulk transfers issued since the daemon started
+    uint64_t transferErrors;       // Number of failed transfers since the daemon started
+    uint64_t transferRetries;      // Number of retried control transfers since the daemon started
+    uint64_t disconnects;          // Number of times the device was found disconnected
+    uint64_t attachCycles;         // Number of times the DUT was attached
+    uint64_t overcurrentTrips;     // Number of times the overcurrent flag was seen to go active
+    uint64_t coalescedRequests;    // Number of switching requests or polls that were coalesced by the worker, instead of being executed on their own
+};
+
+// Function prototypes
+std::string formatMetrics(const std::map<std::string, DeviceMetrics> &metrics);
+int listenMetrics(const std::string &address);
+
+#endif  // METRICS_H
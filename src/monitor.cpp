@@ -0,0 +1,219 @@
+/* ITUSB2 GPIO monitor class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The monitor samples the GPIO signals of a device from a dedicated thread, and records every change in a fixed-size ring log
+// Each slot of the log works as a sequence lock, so the monitor thread never waits on readers, and readers never block each other
+// Since the signals are sampled, the exact moment of a transition is unknown, but it lies within the resolution reported for the event
+
+// Includes
+#include "monitor.h"
+
+// Publishes an event to the log and to the subscribers (private)
+void GPIOMonitor::publish(const Event &event)
+{
+    Slot &slot = log_[event.sequence % capacity_];
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(event.time, std::memory_order_relaxed);
+    slot.resolution.store(event.resolution, std::memory_order_relaxed);
+    slot.signals.store(event.signals, std::memory_order_relaxed);
+    slot.changed.store(event.changed, std::memory_order_relaxed);
+    slot.stamp.store(event.sequence + 1, std::memory_order_release);
+    head_.store(event.sequence + 1, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    for (std::map<int, Subscriber>::const_iterator iter = subscribers_.begin(); iter != subscribers_.end(); ++iter) {
+        iter->second(event);
+    }
+}
+
+// Body of the monitor thread (private)
+void GPIOMonitor::run()
+{
+    uint64_t sequence = 0;
+    uint16_t previous = 0;
+    bool first = true;
+    std::chrono::steady_clock::time_point last = start_, deadline = start_;
+    while (!stop_.load(std::memory_order_acquire)) {
+        int errcnt = 0;
+        std::string errstr;
+        uint16_t signals = device_.getSignals(errcnt, errstr);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (errcnt > 0) {
+            errcnt_ += errcnt;
+            errstr_ += errstr;
+            break;
+        }
+        polls_.fetch_add(1, std::memory_order_relaxed);
+        if (first || signals != previous) {
+            Event event;
+            event.sequence = sequence++;
+            event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+            event.resolution = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+            event.signals = signals;
+            event.changed = first ? 0 : static_cast<uint16_t>(signals ^ previous);
+            publish(event);
+            previous = signals;
+            first = false;
+        }
+        last = now;
+        if (interval_.count() > 0) {  // Sleep until the next poll is due, unless the interval is zero, in which case the thread busy-polls the device (best resolution, at the cost of a CPU core and of USB bandwidth)
+            deadline += interval_;
+            if (deadline < now) {  // Skip the polls that were missed, instead of bursting to catch up
+                deadline = now;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+// "GPIOMonitor" class constructor
+GPIOMonitor::GPIOMonitor(ITUSB2Device &device, size_t capacity) :
+    device_(device),
+    capacity_(capacity > 0 ? capacity : DEFAULT_CAPACITY),
+    log_(new Slot[capacity_]()),
+    head_(0),
+    polls_(0),
+    running_(false),
+    stop_(false),
+    interval_(0),
+    lastSubscriber_(0),
+    errcnt_(0)
+{
+}
+
+// "GPIOMonitor" class destructor
+GPIOMonitor::~GPIOMonitor()
+{
+    int errcnt = 0;
+    std::string errstr;
+    stop(errcnt, errstr);
+}
+
+// Returns the number of events recorded since the monitor was started
+uint64_t GPIOMonitor::events() const
+{
+    return head_.load(std::memory_order_acquire);
+}
+
+// Returns the number of times the signals were polled
+uint64_t GPIOMonitor::polls() const
+{
+    return polls_.load(std::memory_order_relaxed);
+}
+
+// Returns true if the monitor thread is running
+bool GPIOMonitor::running() const
+{
+    return running_.load(std::memory_order_acquire);
+}
+
+// Returns the wall clock time at which the monitor was started, to which event times are relative
+std::chrono::system_clock::time_point GPIOMonitor::startTime() const
+{
+    return startTime_;
+}
+
+// Appends the events recorded after the given cursor to the given vector, and advances the cursor
+// Returns the number of events that were overwritten before they could be read, which are skipped
+uint64_t GPIOMonitor::read(uint64_t &cursor, std::vector<Event> &events) const
+{
+    uint64_t lost = 0;
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head > capacity_ && cursor < head - capacity_) {
+        lost += head - capacity_ - cursor;
+        cursor = head - capacity_;
+    }
+    while (cursor < head) {
+        const Slot &slot = log_[cursor % capacity_];
+        Event event;
+        uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+        event.time = slot.time.load(std::memory_order_relaxed);
+        event.resolution = slot.resolution.load(std::memory_order_relaxed);
+        event.signals = slot.signals.load(std::memory_order_relaxed);
+        event.changed = slot.changed.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (stamp != cursor + 1 || slot.stamp.load(std::memory_order_relaxed) != stamp) {  // The slot was overwritten while being read, so the reader has fallen behind by a whole lap
+            uint64_t newHead = head_.load(std::memory_order_acquire);
+            uint64_t oldest = newHead > capacity_ ? newHead - capacity_ + 1 : 0;  // The slot after the head may be under write, so it is skipped as well
+            lost += oldest > cursor ? oldest - cursor : 1;
+            cursor = oldest > cursor ? oldest : cursor + 1;
+            head = newHead;
+            continue;
+        }
+        event.sequence = cursor;
+        events.push_back(event);
+        ++cursor;
+    }
+    return lost;
+}
+
+// Starts the monitor thread, polling the signals at the given interval (zero means that the thread polls continuously)
+// Note that the device must not be operated by other threads while the monitor is running, except if the operations are serialized by the caller
+void GPIOMonitor::start(const std::chrono::microseconds &interval)
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        if (thread_.joinable()) {  // A previous run ended on its own, due to an error
+            thread_.join();
+        }
+        head_.store(0, std::memory_order_relaxed);
+        polls_.store(0, std::memory_order_relaxed);
+        stop_.store(false, std::memory_order_relaxed);
+        interval_ = interval;
+        errcnt_ = 0;
+        errstr_.clear();
+        for (size_t i = 0; i < capacity_; ++i) {
+            log_[i].stamp.store(0, std::memory_order_relaxed);
+        }
+        startTime_ = std::chrono::system_clock::now();
+        start_ = std::chrono::steady_clock::now();
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&GPIOMonitor::run, this);
+    }
+}
+
+// Stops the monitor thread, reporting any errors that caused it to stop on its own
+void GPIOMonitor::stop(int &errcnt, std::string &errstr)
+{
+    stop_.store(true, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+        errcnt += errcnt_;
+        errstr += errstr_;
+        errcnt_ = 0;
+        errstr_.clear();
+    }
+}
+
+// Registers a function to be called, from the monitor thread, for every event recorded, returning an identifier for it
+// Subscribers should return quickly, since the monitor does not poll while they are running
+int GPIOMonitor::subscribe(const Subscriber &subscriber)
+{
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    subscribers_[++lastSubscriber_] = subscriber;
+    return lastSubscriber_;
+}
+
+// Removes the subscriber with the given identifier
+void GPIOMonitor::unsubscribe(int id)
+{
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    subscribers_.erase(id);
+}
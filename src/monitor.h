@@ -0,0 +1,98 @@
+/* ITUSB2 GPIO monitor class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "itusb2device.h"
+
+class GPIOMonitor
+{
+public:
+    struct Event {
+        uint64_t sequence;   // Sequence number of the event, starting from zero
+        int64_t time;        // Time of the poll that detected the change, in nanoseconds since the monitor was started
+        int64_t resolution;  // Time between that poll and the previous one, in nanoseconds (the change occurred within this interval)
+        uint16_t signals;    // State of the signals after the change (see the SIGNAL_* values of ITUSB2Device)
+        uint16_t changed;    // Signals that changed (none, for the event that holds the initial state)
+    };
+
+    typedef std::function<void(const Event &)> Subscriber;
+
+private:
+    // Slot of the event log, which works as a sequence lock, so that events can be read without ever blocking the monitor thread
+    struct Slot {
+        std::atomic<uint64_t> stamp;        // Sequence number of the event held plus one, or zero while the slot is being written
+        std::atomic<int64_t> time;
+        std::atomic<int64_t> resolution;
+        std::atomic<uint16_t> signals;
+        std::atomic<uint16_t> changed;
+    };
+
+    ITUSB2Device &device_;
+    size_t capacity_;
+    std::unique_ptr<Slot[]> log_;
+    std::atomic<uint64_t> head_;             // Number of events written so far
+    std::atomic<uint64_t> polls_;
+    std::atomic<bool> running_, stop_;
+    std::chrono::microseconds interval_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::system_clock::time_point startTime_;
+    std::thread thread_;
+    std::mutex subscribersMutex_;
+    std::map<int, Subscriber> subscribers_;
+    int lastSubscriber_;
+    int errcnt_;
+    std::string errstr_;
+
+    void publish(const Event &event);
+    void run();
+
+public:
+    // Class definitions
+    static const size_t DEFAULT_CAPACITY = 4096;  // Default number of events kept in the log
+
+    explicit GPIOMonitor(ITUSB2Device &device, size_t capacity = DEFAULT_CAPACITY);
+    ~GPIOMonitor();
+
+    uint64_t events() const;
+    uint64_t polls() const;
+    bool running() const;
+    std::chrono::system_clock::time_point startTime() const;
+
+    uint64_t read(uint64_t &cursor, std::vector<Event> &events) const;
+    void start(const std::chrono::microseconds &interval);
+    void stop(int &errcnt, std::string &errstr);
+    int subscribe(const Subscriber &subscriber);
+    void unsubscribe(int id);
+};
+
+#endif  // MONITOR_H
@@ -0,0 +1,187 @@
+/* ITUSB2 output classes - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <iomanip>
+#include <sstream>
+#include "output.h"
+
+// Escapes a string so that it can be used as a CSV field (quotes are only added if necessary)
+static std::string escapeCSV(const std::string &str)
+{
+    std::string escaped = str;
+    if (str.find_first_of(",\"\r\n") != std::string::npos) {
+        escaped = "\"";
+        for (char c : str) {
+            escaped += c;
+            if (c == '"') {
+                escaped += '"';  // Quotes are escaped by doubling them
+            }
+        }
+        escaped += '"';
+    }
+    return escaped;
+}
+
+// Escapes a string so that it can be used as a JSON string (quotes not included)
+static std::string escapeJSON(const std::string &str)
+{
+    std::ostringstream stream;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            stream << '\\' << c;
+        } else if (c == '\n') {
+            stream << "\\n";
+        } else if (c == '\t') {
+            stream << "\\t";
+        } else if (static_cast<unsigned char>(c) < 0x20) {  // Other control characters
+            stream << "\\u" << std::hex << std::setfill('0') << std::setw(4) << static_cast<int>(c) << std::dec;
+        } else {
+            stream << c;
+        }
+    }
+    return stream.str();
+}
+
+// Appends all fields of another record to this record
+Record &Record::append(const Record &other)
+{
+    fields_.insert(fields_.end(), other.fields_.begin(), other.fields_.end());
+    return *this;
+}
+
+// Adds a boolean field to the record (printed as "true" or "false" in JSON and text, and as 1 or 0 in CSV)
+Record &Record::boolean(const std::string &name, bool value)
+{
+    fields_.push_back({name, value ? "true" : "false", BOOLEAN});
+    return *this;
+}
+
+// Adds an integer field to the record
+Record &Record::integer(const std::string &name, long long value)
+{
+    fields_.push_back({name, std::to_string(value), NUMBER});
+    return *this;
+}
+
+// Adds a decimal number field to the record, using the given number of decimal places
+Record &Record::number(const std::string &name, double value, int precision)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(precision) << value;
+    fields_.push_back({name, stream.str(), NUMBER});
+    return *this;
+}
+
+// Adds a string field to the record
+Record &Record::string(const std::string &name, const std::string &value)
+{
+    fields_.push_back({name, value, STRING});
+    return *this;
+}
+
+Output::Output(int format, std::ostream &out, std::ostream &err) :
+    format_(format),
+    out_(out),
+    err_(err),
+    header_(),
+    errHeader_()
+{
+}
+
+// Writes a record to the given stream, flushing it afterwards so that each record is delivered as soon as it is complete
+void Output::write(const Record &record, std::ostream &stream, std::string &header)
+{
+    if (format_ == CSV) {
+        std::string names, values;
+        for (size_t i = 0; i < record.fields_.size(); ++i) {
+            const Record::Field &field = record.fields_[i];
+            names += (i == 0 ? "" : ",") + field.name;
+            if (field.type == Record::BOOLEAN) {
+                values += (i == 0 ? "" : ",") + std::string(field.value == "true" ? "1" : "0");
+            } else {
+                values += (i == 0 ? "" : ",") + (field.type == Record::STRING ? escapeCSV(field.value) : field.value);
+            }
+        }
+        if (names != header) {  // The header is only printed before the first record, or if the fields change
+            stream << names << "\n";
+            header = names;
+        }
+        stream << values << "\n";
+    } else if (format_ == JSON) {
+        stream << "{";
+        for (size_t i = 0; i < record.fields_.size(); ++i) {
+            const Record::Field &field = record.fields_[i];
+            stream << (i == 0 ? "\"" : ",\"") << field.name << "\":" << (field.type == Record::STRING ? "\"" + escapeJSON(field.value) + "\"" : field.value);
+        }
+        stream << "}\n";
+    } else {  // Text format, in which records are printed as space-separated "name=value" pairs
+        for (size_t i = 0; i < record.fields_.size(); ++i) {
+            stream << (i == 0 ? "" : " ") << record.fields_[i].name << "=" << record.fields_[i].value;
+        }
+        stream << "\n";
+    }
+    stream.flush();
+}
+
+// Returns the output format
+int Output::format() const
+{
+    return format_;
+}
+
+// Reports errors, using the given error code (each error in "errstr" should be terminated with a newline character, as in the strings returned by the device classes)
+// In the text format, each error is printed as "Error: " followed by the error message - Otherwise, an error record is printed for each error
+void Output::error(int code, const std::string &errstr)
+{
+    size_t lnend, lnstart = 0;
+    while ((lnend = errstr.find('\n', lnstart)) != std::string::npos) {
+        std::string message = errstr.substr(lnstart, lnend - lnstart);
+        if (format_ == TEXT) {
+            err_ << "Error: " << message << "\n";
+        } else {
+            write(Record().integer("error_code", code).string("error", message), err_, errHeader_);
+        }
+        lnstart = lnend + 1;
+    }
+    err_.flush();
+}
+
+// Prints a record to the output stream
+void Output::record(const Record &record)
+{
+    write(record, out_, header_);
+}
+
+// Parses the name of an output format ("text", "csv" or "json"), returning false if the given string is not valid
+bool Output::parseFormat(const std::string &str, int &format)
+{
+    bool retval = true;
+    if (str == "text") {
+        format = TEXT;
+    } else if (str == "csv") {
+        format = CSV;
+    } else if (str == "json") {
+        format = JSON;
+    } else {
+        retval = false;
+    }
+    return retval;
+}
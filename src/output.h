@@ -0,0 +1,87 @@
+/* ITUSB2 output classes - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+// Includes
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Error codes, as reported in machine-readable error records (the first three are equal to the values returned by ITUSB2Device::open())
+const int ERRCODE_INIT = 1;          // Could not initialize libusb
+const int ERRCODE_NOT_FOUND = 2;     // Device not found
+const int ERRCODE_BUSY = 3;          // Device is in use
+const int ERRCODE_DISCONNECTED = 4;  // Device disconnected
+const int ERRCODE_DEVICE = 5;        // Failed operation (e.g., failed transfer)
+const int ERRCODE_USAGE = 6;         // Unknown command or invalid arguments
+const int ERRCODE_TIMEOUT = 7;       // Device did not respond in time
+const int ERRCODE_FILE = 8;          // Could not open or write to a file
+
+class Record
+{
+private:
+    enum Type {BOOLEAN, NUMBER, STRING};
+
+    struct Field {
+        std::string name;   // Field name
+        std::string value;  // Field value, already converted to text
+        Type type;          // Field type, which determines how the value is printed (booleans are printed as 1 or 0 in CSV, and strings are quoted in JSON)
+    };
+
+    std::vector<Field> fields_;
+
+public:
+    Record &append(const Record &other);
+    Record &boolean(const std::string &name, bool value);
+    Record &integer(const std::string &name, long long value);
+    Record &number(const std::string &name, double value, int precision);
+    Record &string(const std::string &name, const std::string &value);
+
+    friend class Output;
+};
+
+class Output
+{
+private:
+    int format_;
+    std::ostream &out_, &err_;
+    std::string header_, errHeader_;  // Last CSV headers printed to each stream
+
+    void write(const Record &record, std::ostream &stream, std::string &header);
+
+public:
+    // Class definitions
+    static const int TEXT = 0;  // Human readable text (the default)
+    static const int CSV = 1;   // Comma-separated values, with a header line printed before the first record and whenever the fields change
+    static const int JSON = 2;  // One JSON object per line
+
+    Output(int format, std::ostream &out, std::ostream &err);
+
+    int format() const;
+
+    void error(int code, const std::string &errstr);
+    void record(const Record &record);
+
+    static bool parseFormat(const std::string &str, int &format);
+};
+
+#endif  // OUTPUT_H
@@ -0,0 +1,234 @@
+/* ITUSB2 daemon protocol functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The protocol is line based, and each connection can carry any number of requests, which are answered in order
+// A request consists of the serial number (empty for the default device), the command name and its parameters, all separated by tabs and terminated by a newline
+// A response consists of a header line containing the exit status and the lengths of the standard output and error texts, separated by spaces, followed by both texts
+
+// Includes
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "protocol.h"
+
+// Definitions
+const char USER_SOCKET[] = "itusb2d.sock";  // Name of the socket of a daemon run by any other user, within the runtime directory of that user
+const size_t READ_CHUNK = 4096;              // Maximum number of bytes read at once from a socket
+
+// Connects to the socket having the given path, returning the socket file descriptor, or -1 if no daemon is listening on it
+static int connectSocket(const std::string &path)
+{
+    int fd = -1;
+    sockaddr_un addr;
+    if (!path.empty() && path.size() < sizeof(addr.sun_path)) {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0) {
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::strcpy(addr.sun_path, path.c_str());
+            if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {  // Typically fails with ENOENT or ECONNREFUSED if the daemon is not running
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+    return fd;
+}
+
+// Returns the path of the socket in the runtime directory of the current user, or an empty string if that directory is not known
+static std::string userSocketPath()
+{
+    const char *runtime = std::getenv("XDG_RUNTIME_DIR");
+    return runtime == nullptr || *runtime == '\0' ? std::string() : std::string(runtime) + "/" + USER_SOCKET;
+}
+
+// Connects to the daemon, returning the socket file descriptor, or -1 if the daemon is not running (or if disabled)
+// Unless the socket is given by ITUSB2D_SOCKET, a daemon run by the current user is preferred over a system daemon
+int connectDaemon()
+{
+    int fd;
+    if (std::getenv("ITUSB2D_SOCKET") != nullptr || geteuid() == 0) {
+        fd = connectSocket(daemonSocketPath());
+    } else if ((fd = connectSocket(userSocketPath())) < 0) {
+        fd = connectSocket(SYSTEM_SOCKET);
+    }
+    return fd;
+}
+
+// Returns the path of the socket the daemon listens on (an empty string means that the daemon should not be used)
+// Unless overridden using the ITUSB2D_SOCKET environment variable, a daemon run by root listens in a directory that only root can create, and a daemon run by any other user listens in the runtime directory of that user, which only that user can access - Either way, no other user can impersonate the daemon
+std::string daemonSocketPath()
+{
+    const char *env = std::getenv("ITUSB2D_SOCKET");
+    std::string path;
+    if (env != nullptr) {
+        path = env;
+    } else if (geteuid() == 0) {
+        path = SYSTEM_SOCKET;
+    } else {
+        path = userSocketPath();
+    }
+    return path;
+}
+
+// Decodes a request line (without the newline character), returning false if it is malformed
+bool decodeRequest(const std::string &line, std::string &serial, std::vector<std::string> &args)
+{
+    std::vector<std::string> fields;
+    size_t start = 0, end;
+    while ((end = line.find('\t', start)) != std::string::npos) {
+        fields.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+    fields.push_back(line.substr(start));
+    bool valid = fields.size() >= 2 && !fields[1].empty();  // At least the serial number (even if empty) and the command name are required
+    if (valid) {
+        serial = fields[0];
+        args.assign(fields.begin() + 1, fields.end());
+    }
+    return valid;
+}
+
+// Encodes a request
+std::string encodeRequest(const std::string &serial, const std::vector<std::string> &args)
+{
+    std::string request = serial;
+    for (const std::string &arg : args) {
+        request += '\t';
+        request += arg;
+    }
+    request += '\n';
+    return request;
+}
+
+// Encodes a response
+std::string encodeResponse(int status, const std::string &out, const std::string &err)
+{
+    std::ostringstream stream;
+    stream << status << " " << out.size() << " " << err.size() << "\n" << out << err;
+    return stream.str();
+}
+
+// Forwards a command to the daemon, returning its results through "out" and "err", and returns false if the daemon is not running
+bool queryDaemon(const std::string &serial, const std::vector<std::string> &args, int &errlvl, std::string &out, std::string &err)
+{
+    int fd = connectDaemon();
+    if (fd >= 0) {
+        std::string buffer, header;
+        bool valid = writeAll(fd, encodeRequest(serial, args)) && readLine(fd, buffer, header);
+        if (valid) {
+            std::istringstream stream(header);
+            size_t outlen, errlen;
+            valid = static_cast<bool>(stream >> errlvl >> outlen >> errlen) && readBytes(fd, buffer, outlen, out) && readBytes(fd, buffer, errlen, err);
+        }
+        if (!valid) {
+            out.clear();
+            err = "Error: Lost connection to daemon.\n";
+            errlvl = EXIT_FAILURE;
+        }
+        ::close(fd);
+    }
+    return fd >= 0;
+}
+
+// Reads exactly "size" bytes, using any data already present in "buffer" first, and returns false on failure
+bool readBytes(int fd, std::string &buffer, size_t size, std::string &data)
+{
+    char chunk[READ_CHUNK];
+    while (buffer.size() < size) {
+        ssize_t nbytes = read(fd, chunk, sizeof(chunk));
+        if (nbytes < 0 && errno == EINTR) {
+            continue;
+        } else if (nbytes <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(nbytes));
+    }
+    data = buffer.substr(0, size);
+    buffer.erase(0, size);
+    return true;
+}
+
+// Reads a line, without the newline character, using any data already present in "buffer" first, and returns false on failure or at the end of the stream
+bool readLine(int fd, std::string &buffer, std::string &line)
+{
+    char chunk[READ_CHUNK];
+    size_t end;
+    while ((end = buffer.find('\n')) == std::string::npos) {
+        ssize_t nbytes = read(fd, chunk, sizeof(chunk));
+        if (nbytes < 0 && errno == EINTR) {
+            continue;
+        } else if (nbytes <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(nbytes));
+    }
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+    return true;
+}
+
+// Requests the daemon to close the device having the given serial number (or the default device, if the serial number is empty), so that it can be opened by another process
+// Returns true if the daemon is running and released the device
+bool releaseDevice(const std::string &serial)
+{
+    bool released = false;
+    int fd = connectDaemon();
+    if (fd >= 0) {
+        std::string buffer, header;
+        released = writeAll(fd, encodeRequest(serial, {"release"})) && readLine(fd, buffer, header) && header.compare(0, 2, "0 ") == 0;
+        ::close(fd);
+    }
+    return released;
+}
+
+// Forwards a command to the daemon, printing its results, and returns false if the daemon is not running
+bool requestDaemon(const std::string &serial, const std::vector<std::string> &args, int &errlvl)
+{
+    std::string out, err;
+    bool running = queryDaemon(serial, args, errlvl, out, err);
+    if (running) {
+        std::cout << out;
+        std::cout.flush();
+        std::cerr << err;
+    }
+    return running;
+}
+
+// Writes all the given data, and returns false on failure
+bool writeAll(int fd, const std::string &data)
+{
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t nbytes = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);  // MSG_NOSIGNAL prevents SIGPIPE if the peer disconnects
+        if (nbytes < 0 && errno == EINTR) {
+            continue;
+        } else if (nbytes <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(nbytes);
+    }
+    return true;
+}
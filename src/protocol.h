@@ -0,0 +1,46 @@
+/* ITUSB2 daemon protocol functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Includes
+#include <string>
+#include <vector>
+
+// Definitions
+const char DAEMON_GROUP[] = "plugdev";                    // Group allowed to use a system daemon, which is also the group of the devices (see the udev rules installed by install.sh)
+const char SYSTEM_SOCKET[] = "/run/itusb2d/itusb2d.sock";  // Socket of a daemon run by root
+const char SYSTEM_SOCKET_DIR[] = "/run/itusb2d";           // Directory containing the above, which only root can create
+
+// Function prototypes
+int connectDaemon();
+std::string daemonSocketPath();
+bool decodeRequest(const std::string &line, std::string &serial, std::vector<std::string> &args);
+std::string encodeRequest(const std::string &serial, const std::vector<std::string> &args);
+std::string encodeResponse(int status, const std::string &out, const std::string &err);
+bool queryDaemon(const std::string &serial, const std::vector<std::string> &args, int &errlvl, std::string &out, std::string &err);
+bool readBytes(int fd, std::string &buffer, size_t size, std::string &data);
+bool readLine(int fd, std::string &buffer, std::string &line);
+bool releaseDevice(const std::string &serial);
+bool requestDaemon(const std::string &serial, const std::vector<std::string> &args, int &errlvl);
+bool writeAll(int fd, const std::string &data);
+
+#endif  // PROTOCOL_H
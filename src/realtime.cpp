@@ -0,0 +1,165 @@
+/* ITUSB2 real-time functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Real-time mode is opt-in, and it is requested by setting ITUSB2_REALTIME to "PRIORITY[:CPU]" (e.g., "50" or "50:2")
+// It raises the calling thread to the SCHED_FIFO policy, locks the memory of the process, and optionally pins the calling thread to a CPU, so that timing-critical waits are not delayed by other load
+// Threads created afterwards inherit both the scheduling policy and the affinity
+
+// Includes
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "realtime.h"
+
+// Definitions
+const std::chrono::milliseconds MAX_SLEEP(100);  // Maximum duration of a single sleep of the stoppable sleepUntil(), so that a stop request is noticed promptly
+
+// Appends a failure reason to the given string
+static void addFailure(std::string &failures, const std::string &what, int err)
+{
+    failures += (failures.empty() ? "" : "; ") + what + ": " + std::strerror(err);
+}
+
+// Returns a one-line description of the real-time settings that are in effect, including any fallbacks
+std::string describeRealtime(const RealtimeStatus &status)
+{
+    std::string description;
+    if (!status.requested) {
+        description = "Real-time mode not requested";
+    } else if (!status.scheduling && !status.locked && !status.pinned) {
+        description = "Real-time mode unavailable, running with normal priority (" + status.failures + ")";
+    } else {
+        description = "Real-time mode: ";
+        description += status.scheduling ? "SCHED_FIFO priority " + std::to_string(status.config.priority) : "normal priority";
+        description += status.locked ? (status.lockedFuture ? ", memory locked" : ", current memory locked") : ", memory not locked";
+        if (status.config.cpu >= 0) {
+            description += status.pinned ? ", pinned to CPU " + std::to_string(status.config.cpu) : ", not pinned";
+        }
+        if (!status.failures.empty()) {
+            description += " (" + status.failures + ")";
+        }
+    }
+    return description;
+}
+
+// Applies the given real-time settings to the calling thread (and to the whole process, in the case of memory locking)
+// Each setting that cannot be applied, typically due to missing privileges (CAP_SYS_NICE, CAP_IPC_LOCK or RLIMIT_MEMLOCK), is skipped and reported, instead of being treated as an error
+RealtimeStatus enableRealtime(const RealtimeConfig &config)
+{
+    RealtimeStatus status = {true, false, false, false, false, config, std::string()};
+    sched_param param;
+    param.sched_priority = config.priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err == 0) {
+        status.scheduling = true;
+    } else {
+        addFailure(status.failures, "SCHED_FIFO", err);
+    }
+    // Memory mapped afterwards is only locked if RLIMIT_MEMLOCK is unlimited, since MCL_FUTURE otherwise makes the creation of threads fail (with EAGAIN) as soon as their stacks exceed the limit
+    rlimit limit;
+    bool future = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+    if (mlockall(future ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT) == 0) {  // Avoid page faults in the middle of timed waits
+        status.locked = true;
+        status.lockedFuture = future;
+    } else {
+        addFailure(status.failures, "mlockall", errno);
+    }
+    if (config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err == 0) {
+            status.pinned = true;
+        } else {
+            addFailure(status.failures, "CPU affinity", err);
+        }
+    }
+    return status;
+}
+
+// Applies the real-time settings given by the ITUSB2_REALTIME environment variable, if set
+// An invalid setting is reported as a failure, and nothing is applied in that case
+RealtimeStatus enableRealtimeFromEnv()
+{
+    RealtimeStatus status = {false, false, false, false, false, {0, -1}, std::string()};
+    const char *env = std::getenv("ITUSB2_REALTIME");
+    if (env != nullptr && *env != '\0') {
+        RealtimeConfig config;
+        if (parseRealtime(env, config)) {
+            status = enableRealtime(config);
+        } else {
+            status.requested = true;
+            status.failures = "invalid ITUSB2_REALTIME setting \"" + std::string(env) + "\"";
+        }
+    }
+    return status;
+}
+
+// Parses a real-time setting in the form "PRIORITY[:CPU]", returning false if it is not valid
+bool parseRealtime(const std::string &spec, RealtimeConfig &config)
+{
+    char *end;
+    long priority = std::strtol(spec.c_str(), &end, 10);
+    long cpu = -1;
+    bool valid = end != spec.c_str() && priority >= sched_get_priority_min(SCHED_FIFO) && priority <= sched_get_priority_max(SCHED_FIFO);
+    if (valid && *end == ':') {
+        const char *start = end + 1;
+        cpu = std::strtol(start, &end, 10);
+        valid = end != start && cpu >= 0 && cpu < CPU_SETSIZE;
+    }
+    valid = valid && *end == '\0';
+    if (valid) {
+        config.priority = static_cast<int>(priority);
+        config.cpu = static_cast<int>(cpu);
+    }
+    return valid;
+}
+
+// Sleeps until the given time is reached, using an absolute deadline, and returns how late the wake-up was
+// Unlike a relative sleep, this is not lengthened by the time taken to compute the delay, nor by the restarts caused by signals
+std::chrono::steady_clock::duration sleepUntil(const std::chrono::steady_clock::time_point &deadline)
+{
+    std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());  // In libstdc++, the epoch of std::chrono::steady_clock is the one of CLOCK_MONOTONIC
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns.count() % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {  // Sleep again if interrupted by a signal handler
+    }
+    return std::chrono::steady_clock::now() - deadline;
+}
+
+// Sleeps until the given time is reached, as above, or until "stop" is set, and returns how late the wake-up was (a stopped sleep returns a negative value)
+// The sleep is split into slices of up to 100ms, each one ending at an absolute time, so the last slice still wakes up at the deadline itself
+std::chrono::steady_clock::duration sleepUntil(const std::chrono::steady_clock::time_point &deadline, const std::atomic<bool> &stop)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (!stop && now < deadline) {
+        sleepUntil(std::min<std::chrono::steady_clock::time_point>(deadline, now + MAX_SLEEP));
+        now = std::chrono::steady_clock::now();
+    }
+    return now - deadline;
+}
@@ -0,0 +1,54 @@
+/* ITUSB2 real-time functions - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Real-time settings, as requested through the ITUSB2_REALTIME environment variable
+struct RealtimeConfig {
+    int priority;  // SCHED_FIFO priority (1 to 99)
+    int cpu;       // CPU to which the process is pinned, or -1 for no affinity
+};
+
+// Outcome of enableRealtime(), which applies each setting independently, so that a missing privilege only disables the respective setting
+struct RealtimeStatus {
+    bool requested;        // True if real-time mode was requested
+    bool scheduling;       // True if the SCHED_FIFO policy was applied
+    bool locked;           // True if memory was locked with mlockall()
+    bool lockedFuture;     // True if memory mapped afterwards (e.g., the stacks of new threads) is locked as well
+    bool pinned;           // True if the CPU affinity was applied
+    RealtimeConfig config;
+    std::string failures;  // Reasons why any of the above settings could not be applied, separated by "; "
+};
+
+// Function prototypes
+std::string describeRealtime(const RealtimeStatus &status);
+RealtimeStatus enableRealtime(const RealtimeConfig &config);
+RealtimeStatus enableRealtimeFromEnv();
+bool parseRealtime(const std::string &spec, RealtimeConfig &config);
+std::chrono::steady_clock::duration sleepUntil(const std::chrono::steady_clock::time_point &deadline);
+std::chrono::steady_clock::duration sleepUntil(const std::chrono::steady_clock::time_point &deadline, const std::atomic<bool> &stop);
+
+#endif  // REALTIME_H
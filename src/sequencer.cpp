@@ -0,0 +1,85 @@
+/* ITUSB2 power sequencer class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The sequencer runs a timeline of steps on the calling thread, sleeping until each step is due with sleepUntil() and an absolute deadline (see realtime.cpp)
+// Absolute deadlines do not accumulate the time taken by the previous steps, nor the latency of each wake-up, so the timing error never builds up along the timeline
+// Steps are executed in the given order, and a step that becomes due while a previous one is still running (e.g., a long WAIT) starts late, which shows in its timing error
+
+// Includes
+#include "realtime.h"
+#include "sequencer.h"
+
+// Returns the time elapsed since the given time point, in nanoseconds
+static int64_t elapsedSince(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// "Sequencer" class constructor
+Sequencer::Sequencer(ITUSB2Device &device) :
+    device_(device)
+{
+}
+
+// Runs the given timeline on the calling thread, and returns the results of the steps that were executed
+// The timeline stops at the first error, or as soon as "stop" is set (e.g., by a signal handler or by another thread), in which case the results are incomplete
+// The timing is only as good as the scheduling of the calling thread, so any real-time settings should be applied to it beforehand (see enableRealtime())
+// Note that SAMPLE steps require the device to be set up beforehand (see ITUSB2Device::setup())
+std::vector<Sequencer::StepResult> Sequencer::run(const std::vector<Step> &steps, const std::atomic<bool> &stop, int &errcnt, std::string &errstr)
+{
+    std::vector<StepResult> results;
+    results.reserve(steps.size());  // No memory is allocated while the timeline runs
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const Step &step : steps) {
+        if (stop || errcnt > 0) {
+            break;
+        }
+        StepResult result;
+        result.scheduled = std::chrono::duration_cast<std::chrono::nanoseconds>(step.offset).count();
+        result.met = true;
+        result.current = 0;
+        sleepUntil(start + step.offset, stop);
+        if (stop) {
+            break;
+        }
+        result.started = elapsedSince(start);
+        if (step.action == POWER_ON || step.action == POWER_OFF) {
+            device_.switchUSBPower(step.action == POWER_ON, errcnt, errstr);
+        } else if (step.action == DATA_ON || step.action == DATA_OFF) {
+            device_.switchUSBData(step.action == DATA_ON, errcnt, errstr);
+        } else if (step.action == WAIT) {
+            std::chrono::steady_clock::time_point deadline = start + std::chrono::nanoseconds(result.started) + step.timeout;
+            do {  // The signals are polled continuously, since the point of waiting is to react as soon as the condition is met
+                uint16_t signals = device_.getSignals(errcnt, errstr);
+                result.met = errcnt == 0 && (signals & step.mask) == (step.value & step.mask);
+            } while (errcnt == 0 && !result.met && !stop && std::chrono::steady_clock::now() < deadline);
+        } else if (step.action == SAMPLE) {
+            result.current = device_.getCurrent(errcnt, errstr);
+        } else {
+            ++errcnt;
+            errstr += "Invalid sequencer action.\n";  // Program logic error
+        }
+        result.finished = elapsedSince(start);
+        if (errcnt == 0) {
+            results.push_back(result);
+        }
+    }
+    return results;
+}
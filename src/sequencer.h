@@ -0,0 +1,68 @@
+/* ITUSB2 power sequencer class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef SEQUENCER_H
+#define SEQUENCER_H
+
+// Includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "itusb2device.h"
+
+class Sequencer
+{
+public:
+    // Class definitions
+    static const int POWER_ON = 0;   // Switches VBUS on
+    static const int POWER_OFF = 1;  // Switches VBUS off
+    static const int DATA_ON = 2;    // Connects the data lines
+    static const int DATA_OFF = 3;   // Disconnects the data lines
+    static const int WAIT = 4;       // Waits until the signals selected by "mask" match "value", or until the timeout expires
+    static const int SAMPLE = 5;     // Takes a current reading
+
+    struct Step {
+        int action;                         // One of the above actions
+        std::chrono::microseconds offset;   // Time at which the step is due, relative to the start of the timeline
+        uint16_t mask;                      // Signals to be checked, in a WAIT step (see the SIGNAL_* values of ITUSB2Device)
+        uint16_t value;                     // Expected state of the above signals (raw, so active low signals must be given as zero to be asserted)
+        std::chrono::microseconds timeout;  // Time limit of a WAIT step, counted from its start
+    };
+
+    struct StepResult {
+        int64_t scheduled;  // Time at which the step was due, in nanoseconds since the start of the timeline
+        int64_t started;    // Time at which the step actually started, in nanoseconds since the start of the timeline
+        int64_t finished;   // Time at which the step completed, in nanoseconds since the start of the timeline
+        bool met;           // False if a WAIT step timed out (true for any other step)
+        float current;      // Current reading, in mA, for a SAMPLE step (zero for any other step)
+    };
+
+private:
+    ITUSB2Device &device_;
+
+public:
+    explicit Sequencer(ITUSB2Device &device);
+
+    std::vector<StepResult> run(const std::vector<Step> &steps, const std::atomic<bool> &stop, int &errcnt, std::string &errstr);
+};
+
+#endif  // SEQUENCER_H
@@ -0,0 +1,124 @@
+/* Statistics class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// Includes
+#include <algorithm>
+#include <cmath>
+#include "statistics.h"
+
+// Private function that returns the samples in ascending order (the sorted copy is only rebuilt after new samples are added)
+const std::vector<double> &Statistics::sorted() const
+{
+    if (!sortedValid_) {
+        sorted_ = samples_;
+        std::sort(sorted_.begin(), sorted_.end());
+        sortedValid_ = true;
+    }
+    return sorted_;
+}
+
+Statistics::Statistics() :
+    samples_(),
+    sorted_(),
+    sortedValid_(true)
+{
+}
+
+// Returns the number of samples
+size_t Statistics::count() const
+{
+    return samples_.size();
+}
+
+// Returns a histogram of the samples, using the given number of equally sized bins between the minimum and the maximum values
+// The width of each bin is returned via "binWidth"
+std::vector<size_t> Statistics::histogram(size_t bins, double &binWidth) const
+{
+    std::vector<size_t> counts(bins, 0);
+    binWidth = 0;
+    if (bins > 0 && !samples_.empty()) {
+        double lowest = min();
+        binWidth = (max() - lowest) / bins;
+        for (double sample : samples_) {
+            size_t bin = binWidth > 0 ? static_cast<size_t>((sample - lowest) / binWidth) : 0;
+            ++counts[bin < bins ? bin : bins - 1];  // The maximum value falls into the last bin
+        }
+    }
+    return counts;
+}
+
+// Returns the maximum value, or zero if there are no samples
+double Statistics::max() const
+{
+    return samples_.empty() ? 0 : sorted().back();
+}
+
+// Returns the arithmetic mean, or zero if there are no samples
+double Statistics::mean() const
+{
+    double sum = 0;
+    for (double sample : samples_) {
+        sum += sample;
+    }
+    return samples_.empty() ? 0 : sum / samples_.size();
+}
+
+// Returns the minimum value, or zero if there are no samples
+double Statistics::min() const
+{
+    return samples_.empty() ? 0 : sorted().front();
+}
+
+// Returns the given percentile (0 to 100), using the nearest-rank method, or zero if there are no samples
+double Statistics::percentile(double p) const
+{
+    double retval = 0;
+    if (!samples_.empty()) {
+        const std::vector<double> &values = sorted();
+        size_t rank = static_cast<size_t>(std::ceil(p / 100 * values.size()));
+        retval = values[rank > 0 ? (rank <= values.size() ? rank - 1 : values.size() - 1) : 0];
+    }
+    return retval;
+}
+
+// Returns the population standard deviation, or zero if there are no samples
+double Statistics::stddev() const
+{
+    double average = mean(), sum = 0;
+    for (double sample : samples_) {
+        sum += (sample - average) * (sample - average);
+    }
+    return samples_.empty() ? 0 : std::sqrt(sum / samples_.size());
+}
+
+// Adds a sample
+void Statistics::add(double value)
+{
+    samples_.push_back(value);
+    sortedValid_ = false;
+}
+
+// Removes all samples
+void Statistics::clear()
+{
+    samples_.clear();
+    sorted_.clear();
+    sortedValid_ = true;
+}
@@ -0,0 +1,52 @@
+/* Statistics class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+// Includes
+#include <cstddef>
+#include <vector>
+
+class Statistics
+{
+private:
+    std::vector<double> samples_;
+    mutable std::vector<double> sorted_;
+    mutable bool sortedValid_;
+
+    const std::vector<double> &sorted() const;
+
+public:
+    Statistics();
+
+    size_t count() const;
+    std::vector<size_t> histogram(size_t bins, double &binWidth) const;
+    double max() const;
+    double mean() const;
+    double min() const;
+    double percentile(double p) const;
+    double stddev() const;
+
+    void add(double value);
+    void clear();
+};
+
+#endif  // STATISTICS_H
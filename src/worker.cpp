@@ -0,0 +1,304 @@
+/* ITUSB2 device worker class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+// The worker serializes every operation on a device through a single thread, so that any number of threads can request operations without locking
+// Requests are posted to an intrusive multiple-producer single-consumer list: producers only swap the head pointer, and never wait on each other or on the device
+// The worker takes the requests in batches, and coalesces redundant requests within each batch before executing them
+// Namely, a write that is immediately superseded by another write to the same lines is skipped, and consecutive identical reads share a single transfer
+// Coalesced requests complete with the result of the request they were merged with
+
+// Includes
+#include <memory>
+#include "worker.h"
+
+// Returns the lines written by the given operation, or zero if the operation is not a write
+static uint16_t linesWritten(int operation)
+{
+    uint16_t lines;
+    if (operation == DeviceWorker::SWITCH_POWER) {
+        lines = ITUSB2Device::LINES_POWER;
+    } else if (operation == DeviceWorker::SWITCH_DATA) {
+        lines = ITUSB2Device::LINES_DATA;
+    } else if (operation == DeviceWorker::SWITCH_USB) {
+        lines = ITUSB2Device::LINES_POWER | ITUSB2Device::LINES_DATA;
+    } else {
+        lines = 0;
+    }
+    return lines;
+}
+
+// Returns true if the given operation is a read, and therefore has no side effects
+static bool isRead(int operation)
+{
+    return operation == DeviceWorker::GET_CURRENT || operation == DeviceWorker::GET_SIGNALS || operation == DeviceWorker::GET_STATUS;
+}
+
+// Fulfills the promise of a request posted by post(int, bool)
+static void setPromise(const std::shared_ptr<std::promise<DeviceWorker::Result>> &promise, const DeviceWorker::Result &result)
+{
+    promise->set_value(result);
+}
+
+// Completes all requests left in the queue, without executing them (private)
+void DeviceWorker::drain()
+{
+    Request *request;
+    while (pending()) {
+        request = pop();
+        if (request == nullptr) {  // A producer is halfway through posting a request
+            std::this_thread::yield();
+        } else {
+            Result result = Result();
+            result.error = "Worker stopped before the operation was executed.\n";
+            if (request->callback) {
+                request->callback(result);
+            }
+            delete request;
+        }
+    }
+}
+
+// Executes a batch of requests, coalescing redundant ones, and completes them in order (private)
+void DeviceWorker::execute(Request *const batch[], size_t count)
+{
+    size_t first = 0;
+    while (first < count) {
+        size_t last = first, representative;  // The requests from "first" to "last" form a group that is served by a single execution of the representative request
+        if (linesWritten(batch[first]->operation) != 0) {  // A run of writes of the same value, each covering at least the lines of the previous one, reduces to the last write
+            while (last + 1 < count && batch[last + 1]->value == batch[last]->value && (linesWritten(batch[last + 1]->operation) & linesWritten(batch[last]->operation)) == linesWritten(batch[last]->operation)) {  // Writes of opposite values are never coalesced, since that would skip a power cycle or a reconnection
+                ++last;
+            }
+            representative = last;
+        } else {
+            if (isRead(batch[first]->operation)) {  // A run of identical reads reduces to the first read
+                while (last + 1 < count && batch[last + 1]->operation == batch[first]->operation) {
+                    ++last;
+                }
+            }
+            representative = first;
+        }
+        Result result = perform(device_, batch[representative]->operation, batch[representative]->value);
+        executed_.fetch_add(1, std::memory_order_relaxed);
+        coalesced_.fetch_add(last - first, std::memory_order_relaxed);
+        for (size_t i = first; i <= last; ++i) {
+            result.coalesced = i != representative;
+            if (batch[i]->callback) {
+                batch[i]->callback(result);
+            }
+            delete batch[i];
+        }
+        first = last + 1;
+    }
+}
+
+// Returns true if there are requests in the queue, including one that a producer is halfway through posting (private)
+// This function must only be called by the worker thread, or while the worker thread is not running
+bool DeviceWorker::pending() const
+{
+    return tail_ != &stub_ || head_.load() != &stub_;
+}
+
+// Takes the oldest request from the queue, or returns a null pointer if the queue is empty or if the oldest request is not fully posted yet (private)
+// This function must only be called by the worker thread, or while the worker thread is not running
+DeviceWorker::Request *DeviceWorker::pop()
+{
+    Request *tail = tail_;
+    Request *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {  // Skip the placeholder
+        if (next == nullptr) {
+            return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        tail_ = next;
+        return tail;
+    }
+    if (tail != head_.load()) {  // Another request was posted, but is not yet linked to this one
+        return nullptr;
+    }
+    push(&stub_);  // Reinsert the placeholder, so that the last request can be taken without leaving the list empty
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+// Appends a request to the queue, which is safe to do from any thread (private)
+void DeviceWorker::push(Request *request)
+{
+    request->next.store(nullptr, std::memory_order_relaxed);
+    Request *previous = head_.exchange(request);  // Sequentially consistent, so that either the worker sees this request before it waits, or the poster sees that the worker is waiting
+    previous->next.store(request, std::memory_order_release);
+}
+
+// Body of the worker thread (private)
+void DeviceWorker::run()
+{
+    Request *batch[MAX_BATCH];
+    while (true) {
+        size_t count = 0;
+        Request *request;
+        while (count < MAX_BATCH && (request = pop()) != nullptr) {
+            batch[count++] = request;
+        }
+        if (count > 0) {
+            execute(batch, count);
+        } else if (pending()) {  // A producer is halfway through posting a request
+            std::this_thread::yield();
+        } else if (stop_.load(std::memory_order_acquire)) {  // Only stop after all requests posted before stop() are served
+            break;
+        } else {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            waiting_.store(true);
+            while (!pending() && !stop_.load(std::memory_order_acquire)) {
+                wakeup_.wait(lock);
+            }
+            waiting_.store(false);
+        }
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+// "DeviceWorker" class constructor
+DeviceWorker::DeviceWorker(ITUSB2Device &device) :
+    device_(device),
+    head_(&stub_),
+    tail_(&stub_),
+    executed_(0),
+    coalesced_(0),
+    running_(false),
+    stop_(false),
+    waiting_(false)
+{
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+}
+
+// "DeviceWorker" class destructor
+DeviceWorker::~DeviceWorker()
+{
+    stop();
+    drain();  // Requests posted after the worker stopped can no longer be executed, but their callers must not be left waiting
+}
+
+// Returns the number of requests that were coalesced, and therefore not executed on their own
+uint64_t DeviceWorker::coalesced() const
+{
+    return coalesced_.load(std::memory_order_relaxed);
+}
+
+// Returns the number of operations executed on the device
+uint64_t DeviceWorker::executed() const
+{
+    return executed_.load(std::memory_order_relaxed);
+}
+
+// Returns true if the worker thread is running
+bool DeviceWorker::running() const
+{
+    return running_.load(std::memory_order_acquire);
+}
+
+// Posts an operation, returning a future that holds its result
+std::future<DeviceWorker::Result> DeviceWorker::post(int operation, bool value)
+{
+    std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> future = promise->get_future();
+    post(operation, value, std::bind(setPromise, promise, std::placeholders::_1));
+    return future;
+}
+
+// Posts an operation, whose result is passed to the given callback (if any)
+// Note that callbacks are called from the worker thread, thus they should return promptly, and must not wait for the results of other requests
+void DeviceWorker::post(int operation, bool value, const Callback &callback)
+{
+    Request *request = new Request;
+    request->operation = operation;
+    request->value = value;
+    request->callback = callback;
+    push(request);
+    if (waiting_.load()) {  // The mutex is only taken if the worker is idle, to ensure that the wakeup is not lost
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeup_.notify_one();
+    }
+}
+
+// Starts the worker thread, which executes the requests posted so far, and those posted from then on
+// Note that the device must not be operated by other threads while the worker is running, except if the operations are serialized by the caller
+void DeviceWorker::start()
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        stop_.store(false, std::memory_order_relaxed);
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&DeviceWorker::run, this);
+    }
+}
+
+// Stops the worker thread, after all requests posted before the call are executed
+void DeviceWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stop_.store(true, std::memory_order_release);
+        wakeup_.notify_one();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// Executes a single operation on the given device, on the calling thread
+// This is what the worker thread does for each request that is not coalesced, and it is also meant for callers that operate the device without a worker
+DeviceWorker::Result DeviceWorker::perform(ITUSB2Device &device, int operation, bool value)
+{
+    Result result = Result();
+    int errcnt = 0;
+    std::string errstr;
+    if (operation == SWITCH_POWER) {
+        device.switchUSBPower(value, errcnt, errstr);
+    } else if (operation == SWITCH_DATA) {
+        device.switchUSBData(value, errcnt, errstr);
+    } else if (operation == SWITCH_USB) {
+        device.switchUSB(value, errcnt, errstr);
+    } else if (operation == GET_CURRENT) {
+        result.current = device.getCurrent(errcnt, errstr);
+    } else if (operation == GET_SIGNALS) {
+        result.signals = device.getSignals(errcnt, errstr);
+    } else if (operation == GET_STATUS) {
+        result.status = device.getStatus(errcnt, errstr);
+    } else if (operation == ATTACH) {
+        device.attach(errcnt, errstr);
+    } else if (operation == DETACH) {
+        device.detach(errcnt, errstr);
+    } else {
+        ++errcnt;
+        errstr += "Invalid operation.\n";
+    }
+    result.success = errcnt == 0;
+    result.error = errstr;
+    return result;
+}
@@ -0,0 +1,102 @@
+/* ITUSB2 device worker class - Version 1.0.0
+   Copyright (c) 2022 Samuel Lourenço
+
+   This library is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or (at your
+   option) any later version.
+
+   This library is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library.  If not, see <https://www.gnu.org/licenses/>.
+
+
+   Please feel free to contact me via e-mail: samuel.fmlourenco@gmail.com */
+
+
+#ifndef WORKER_H
+#define WORKER_H
+
+// Includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "itusb2device.h"
+
+class DeviceWorker
+{
+public:
+    struct Result {
+        bool success;                 // True if the operation succeeded
+        bool coalesced;               // True if the operation was merged with another one, instead of being executed on its own
+        std::string error;            // Errors that occurred, if any
+        ITUSB2Device::Status status;  // Status, for GET_STATUS
+        float current;                // Current reading in mA, for GET_CURRENT
+        uint16_t signals;             // Signals, for GET_SIGNALS (see the SIGNAL_* values of ITUSB2Device)
+    };
+
+    typedef std::function<void(const Result &)> Callback;
+
+private:
+    // Node of the request queue, which is an intrusive multiple-producer single-consumer linked list (producers only swap the head, so posting never blocks)
+    struct Request {
+        std::atomic<Request *> next;
+        int operation;
+        bool value;
+        Callback callback;
+    };
+
+    ITUSB2Device &device_;
+    std::atomic<Request *> head_;  // Last request posted
+    Request *tail_;                // Oldest request not yet taken, only accessed by the worker thread
+    Request stub_;                 // Placeholder node that keeps the list from ever being empty
+    std::atomic<uint64_t> executed_, coalesced_;
+    std::atomic<bool> running_, stop_, waiting_;
+    std::mutex wakeMutex_;
+    std::condition_variable wakeup_;
+    std::thread thread_;
+
+    void drain();
+    void execute(Request *const batch[], size_t count);
+    bool pending() const;
+    Request *pop();
+    void push(Request *request);
+    void run();
+
+public:
+    // Class definitions
+    static const int SWITCH_POWER = 0;   // Switches VBUS on or off, according to the given value
+    static const int SWITCH_DATA = 1;    // Connects or disconnects the data lines, according to the given value
+    static const int SWITCH_USB = 2;     // Switches both VBUS and the data lines, according to the given value
+    static const int GET_CURRENT = 3;    // Takes a current reading
+    static const int GET_SIGNALS = 4;    // Reads the GPIO signals
+    static const int GET_STATUS = 5;     // Reads the status
+    static const int ATTACH = 6;         // Attaches the DUT
+    static const int DETACH = 7;         // Detaches the DUT
+    static const size_t MAX_BATCH = 64;  // Maximum number of requests taken from the queue at once (only requests within the same batch are coalesced)
+
+    explicit DeviceWorker(ITUSB2Device &device);
+    ~DeviceWorker();
+
+    uint64_t coalesced() const;
+    uint64_t executed() const;
+    bool running() const;
+
+    std::future<Result> post(int operation, bool value = false);
+    void post(int operation, bool value, const Callback &callback);
+    void start();
+    void stop();
+
+    static Result perform(ITUSB2Device &device, int operation, bool value);
+};
+
+#endif  // WORKER_H